@@ -0,0 +1,47 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+#include <stddef.h>
+
+#include "avr_compiler.h"
+#include "antennas.h"
+
+#define ANTENNA_LIST_4(m, n)  m(n, 0), m(n, 1), m(n, 2), m(n, 3)
+#define ANTENNA_LIST_8(m, n)  ANTENNA_LIST_4(m, n), m(n, 4), m(n, 5), m(n, 6), m(n, 7)
+#define ANTENNA_LIST_16(m, n) ANTENNA_LIST_8(m, n), m(n, 8), m(n, 9), m(n, 10), m(n, 11), \
+                              m(n, 12), m(n, 13), m(n, 14), m(n, 15)
+
+static const uint8_t port_4[4] PROGMEM = { ANTENNA_LIST_4(ANTENNA_PORT_PATTERN, 4) };
+static const uint8_t port_8[8] PROGMEM = { ANTENNA_LIST_8(ANTENNA_PORT_PATTERN, 8) };
+static const uint8_t port_16[16] PROGMEM = { ANTENNA_LIST_16(ANTENNA_PORT_PATTERN, 16) };
+
+static const uint16_t dac_4[4] PROGMEM = { ANTENNA_LIST_4(ANTENNA_DAC_NEXT, 4) };
+static const uint16_t dac_8[8] PROGMEM = { ANTENNA_LIST_8(ANTENNA_DAC_NEXT, 8) };
+static const uint16_t dac_16[16] PROGMEM = { ANTENNA_LIST_16(ANTENNA_DAC_NEXT, 16) };
+
+static const antenna_table_t tables[] = {
+	{ 4, 2, ANTENNA_PORT_PINS(4), port_4, dac_4 },
+	{ 8, 3, ANTENNA_PORT_PINS(8), port_8, dac_8 },
+	{ 16, 4, ANTENNA_PORT_PINS(16), port_16, dac_16 },
+};
+
+/*! \brief Look up the pattern tables for an array size.
+ *
+ *  \param  count  number of antennas
+ *
+ *  \return the tables, or NULL when they are not generated for \em count
+ */
+const antenna_table_t *antenna_table(uint8_t count)
+{
+	for (uint8_t i = 0; i < sizeof(tables) / sizeof(tables[0]); ++i)
+	{
+		if (tables[i].count == count)
+			return &tables[i];
+	}
+	return NULL;
+}
@@ -0,0 +1,59 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+#ifndef ANTENNAS_H
+#define ANTENNAS_H
+
+#include "avr_compiler.h"
+
+/*! \brief Largest array the tables are generated for. */
+#define ANTENNA_COUNT_MAX 16
+
+/*! \brief PORTD value that selects antenna \em i of an array of \em n.
+ *
+ *  Default: the antenna index binary coded on PD0 and up. Define it before
+ *  including this header (e.g. with -D in the Makefile) for other switches,
+ *  ANTENNA_PORT_PINS must then cover every pin it uses.
+ */
+#ifndef ANTENNA_PORT_PATTERN
+#define ANTENNA_PORT_PATTERN(n, i) (i)
+#define ANTENNA_PORT_PINS(n) ((n) - 1)
+#elif !defined(ANTENNA_PORT_PINS)
+#error "ANTENNA_PORT_PATTERN needs ANTENNA_PORT_PINS"
+#endif
+
+/*! \brief 12 bit DAC marker level of antenna \em i of an array of \em n. */
+#ifndef ANTENNA_DAC_LEVEL
+#define ANTENNA_DAC_LEVEL(n, i) ((i) * (4096 / (n)))
+#endif
+
+/* The DAC table holds the level of the antenna after i, it is loaded a step ahead. */
+#define ANTENNA_DAC_NEXT(n, i) ANTENNA_DAC_LEVEL(n, ((i) + 1) & ((n) - 1))
+
+_Static_assert(ANTENNA_PORT_PINS(ANTENNA_COUNT_MAX) <= 0xFF, "antenna pins do not fit PORTD");
+_Static_assert(ANTENNA_DAC_LEVEL(ANTENNA_COUNT_MAX, ANTENNA_COUNT_MAX - 1) <= 0xFFF, "marker level above 12 bit");
+_Static_assert(ANTENNA_DAC_LEVEL(4, 0) == 0 && ANTENNA_DAC_LEVEL(8, 0) == 0 &&
+               ANTENNA_DAC_LEVEL(16, 0) == 0, "antenna 0 marker level must be the same for every array");
+
+/*! \brief Pattern tables for one array size, the tables are in flash. */
+typedef struct antenna_table {
+	/* \brief Number of antennas, a power of two. */
+	uint8_t count;
+	/* \brief log2(count), bits of the antenna index. */
+	uint8_t bits;
+	/* \brief PORTD pins the patterns use. */
+	uint8_t pins;
+	/* \brief PORTD value per antenna (flash). */
+	const uint8_t *port;
+	/* \brief DAC level of the next antenna, per antenna (flash). */
+	const uint16_t *dac;
+} antenna_table_t;
+
+const antenna_table_t *antenna_table(uint8_t count);
+
+#endif
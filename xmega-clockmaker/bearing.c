@@ -0,0 +1,211 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "avr_compiler.h"
+#include "commutation.h"
+#include "cordic.h"
+#include "bearing.h"
+#include "log.h"
+#include "load.h"
+
+#if BEARING
+
+/* Mid scale of the unsigned 12 bit ADC result. */
+#define ADC_MID 2048
+
+/* sin(2 pi n / BEARING_SAMPLES) * 127, the cosine is a quarter turn on. */
+static const int8_t sine[BEARING_SAMPLES] = {
+	0, 25, 49, 71, 90, 106, 117, 125, 127, 125, 117, 106, 90, 71, 49, 25,
+	0, -25, -49, -71, -90, -106, -117, -125, -127, -125, -117, -106, -90, -71, -49, -25
+};
+#define SINE_AMPLITUDE 127
+#define QUARTER (BEARING_SAMPLES / 4)
+
+/* One rotation per buffer, DMA CH2 fills one while CH3 fills the other. */
+static uint16_t samples[2][BEARING_SAMPLES];
+/* Bit n: buffer n is full and not processed yet. */
+static volatile uint8_t ready;
+static volatile uint8_t overruns;
+static uint8_t next_buffer;
+
+/* Mixer sums over the rotations of one estimate. */
+static int32_t sum_i;
+static int32_t sum_q;
+static uint32_t sum_energy;
+static uint8_t rotations;
+
+/* Channel of the double buffer pair, enabled by the other one when that is full. */
+static void AdcDma(DMA_CH_t *ch, uint16_t *dest)
+{
+	ch->CTRLA = 0;
+	ch->CTRLA = DMA_CH_RESET_bm;
+
+	ch->ADDRCTRL = DMA_CH_SRCRELOAD_BURST_gc | DMA_CH_SRCDIR_INC_gc |
+	               DMA_CH_DESTRELOAD_TRANSACTION_gc | DMA_CH_DESTDIR_INC_gc;
+	ch->TRIGSRC = DMA_CH_TRIGSRC_ADCA_CH0_gc;
+	ch->TRFCNT = BEARING_SAMPLES * sizeof(uint16_t);
+
+	ch->SRCADDR0 = (uint8_t)((uint16_t)&ADCA.CH0.RES);
+	ch->SRCADDR1 = (uint8_t)((uint16_t)&ADCA.CH0.RES >> 8);
+	ch->SRCADDR2 = 0;
+	ch->DESTADDR0 = (uint8_t)((uint16_t)dest);
+	ch->DESTADDR1 = (uint8_t)((uint16_t)dest >> 8);
+	ch->DESTADDR2 = 0;
+
+	ch->CTRLB = DMA_CH_TRNINTLVL_LO_gc;
+	ch->CTRLA = DMA_CH_SINGLE_bm | DMA_CH_BURSTLEN_2BYTE_gc;
+}
+
+/*! \brief Start sampling the receiver audio for the bearing estimate.
+ *
+ *  The audio goes to PA1 (ADCA, single ended, reference VCC/1.6), biased to
+ *  about 1 V. TCE0 is locked to the antenna steps with commutation_lock_timer()
+ *  and triggers a conversion BEARING_SAMPLES times per rotation through event
+ *  channel 3. DMA CH2 and CH3 in double buffer mode store one rotation each,
+ *  the first buffer starts at a rotation start.
+ *
+ *  Call after commutation_init(), it uses the DMA controller set up there.
+ *
+ *  \retval true   sampling starts at the next rotation start
+ *  \retval false  the commutation mode or plan has no steps to sample in
+ *                 sync with, e.g. the 64 samples of COMMUTATION_MODE_CROSSFADE;
+ *                 the ADC and DMA CH2/CH3 are left off
+ */
+bool bearing_init(void)
+{
+	/* nothing is touched when the lock is refused, and the lock only starts
+	 * TCE0 at a rotation start after the DMA below is armed */
+	AVR_ENTER_CRITICAL_REGION();
+	if (!commutation_lock_timer(&TCE0, BEARING_SAMPLES))
+	{
+		AVR_LEAVE_CRITICAL_REGION();
+		return false;
+	}
+
+	ready = 0;
+	overruns = 0;
+	next_buffer = 0;
+	sum_i = 0;
+	sum_q = 0;
+	sum_energy = 0;
+	rotations = 0;
+
+	PORTA.PIN1CTRL = PORT_ISC_INPUT_DISABLE_gc;
+
+	ADCA.CTRLA = 0;
+	ADCA.CTRLB = ADC_RESOLUTION_12BIT_gc;
+	ADCA.REFCTRL = ADC_REFSEL_INTVCC_gc;
+	ADCA.PRESCALER = ADC_PRESCALER_DIV16_gc;
+	ADCA.EVCTRL = ADC_EVSEL_3456_gc | ADC_EVACT_CH0_gc;
+	ADCA.CH0.CTRL = ADC_CH_INPUTMODE_SINGLEENDED_gc | ADC_CH_GAIN_1X_gc;
+	ADCA.CH0.MUXCTRL = ADC_CH_MUXPOS_PIN1_gc;
+	ADCA.CTRLA = ADC_ENABLE_bm;
+
+	EVSYS.CH3MUX = EVSYS_CHMUX_TCE0_OVF_gc;
+
+	AdcDma(&DMA.CH2, samples[0]);
+	AdcDma(&DMA.CH3, samples[1]);
+	DMA.CTRL |= DMA_ENABLE_bm | DMA_DBUFMODE_CH23_gc;
+	DMA.CH2.CTRLA |= DMA_CH_ENABLE_bm;
+	AVR_LEAVE_CRITICAL_REGION();
+	return true;
+}
+
+/*! \brief Process the sampled rotations, call from the main loop.
+ *
+ *  Every rotation is mixed with a cosine and sine at the rotation frequency
+ *  (one DFT bin, the table is exact because the sampling is locked to the
+ *  rotation). The sums of BEARING_AVERAGE rotations give the phase of the
+ *  Doppler tone against the rotation start, which is the bearing.
+ *
+ *  \param  bearing  result, only written when true is returned
+ *
+ *  \retval true   a new bearing is in \em bearing
+ *  \retval false  still averaging
+ */
+bool bearing_poll(bearing_t *bearing)
+{
+	const uint16_t *x;
+	int32_t i = 0;
+	int32_t q = 0;
+	int32_t dc = 0;
+	uint32_t energy = 0;
+
+	if (!(ready & (1 << next_buffer)))
+		return false;
+
+	x = samples[next_buffer];
+	for (uint8_t n = 0; n < BEARING_SAMPLES; ++n)
+	{
+		int16_t v = x[n] - ADC_MID;
+
+		/* sample n is taken at the end of its share of the rotation */
+		i += (int32_t)v * sine[(n + 1 + QUARTER) % BEARING_SAMPLES];
+		q += (int32_t)v * sine[(n + 1) % BEARING_SAMPLES];
+		dc += v;
+		energy += (int32_t)v * v;
+	}
+	AVR_ENTER_CRITICAL_REGION();
+	ready &= ~(1 << next_buffer);
+	AVR_LEAVE_CRITICAL_REGION();
+	next_buffer ^= 1;
+
+	sum_i += i;
+	sum_q += q;
+	/* AC energy only, the mixer does not see DC either */
+	sum_energy += energy - (uint32_t)(((int64_t)dc * dc) / BEARING_SAMPLES);
+	if (++rotations < BEARING_AVERAGE)
+		return false;
+
+	/* energy of the tone: |iq|^2 / (amplitude^2 * samples / 2 * rotations) */
+	uint64_t tone = ((int64_t)sum_i * sum_i + (int64_t)sum_q * sum_q) /
+	                ((uint32_t)SINE_AMPLITUDE * SINE_AMPLITUDE * (BEARING_SAMPLES / 2) * BEARING_AVERAGE);
+
+	bearing->angle = cordic_atan2(sum_q, sum_i, NULL) + BEARING_OFFSET;
+	bearing->quality = sum_energy ? tone * 100 / sum_energy : 0;
+	bearing->overruns = overruns;
+
+	sum_i = 0;
+	sum_q = 0;
+	sum_energy = 0;
+	rotations = 0;
+	return true;
+}
+
+static void BufferFull(uint8_t buffer)
+{
+	if (ready & (1 << buffer))
+	{
+		overruns++;
+		LOG("bearing: rotation lost, %u so far", overruns);
+	}
+	ready |= 1 << buffer;
+}
+
+ISR(DMA_CH2_vect)
+{
+	LOAD_ENTER();
+
+	DMA.CH2.CTRLB |= DMA_CH_TRNIF_bm;
+	BufferFull(0);
+	LOAD_LEAVE(LOAD_BEARING);
+}
+
+ISR(DMA_CH3_vect)
+{
+	LOAD_ENTER();
+
+	DMA.CH3.CTRLB |= DMA_CH_TRNIF_bm;
+	BufferFull(1);
+	LOAD_LEAVE(LOAD_BEARING);
+}
+
+#endif
@@ -0,0 +1,54 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+#ifndef BEARING_H
+#define BEARING_H
+
+#include "avr_compiler.h"
+
+/*! \brief Estimate the bearing from the receiver audio on PA1, 0 frees ADCA,
+ *         TCE0 and DMA CH2/CH3.
+ */
+#ifndef BEARING
+#define BEARING 1
+#endif
+
+/*! \brief ADC samples of the receiver audio per rotation (size of the mixer table). */
+#define BEARING_SAMPLES 32
+
+/*! \brief DMA channels holding the sample double buffer (bit n: CHn). */
+#define BEARING_DMA_CHANNELS 0x0C
+
+/*! \brief Rotations averaged into one bearing. */
+#ifndef BEARING_AVERAGE
+#define BEARING_AVERAGE 16
+#endif
+
+/*! \brief Added to every bearing, 65536 = 360 degrees.
+ *
+ *  Covers the audio delay of the receiver and the direction of antenna 0,
+ *  set it with a beacon at a known bearing.
+ */
+#ifndef BEARING_OFFSET
+#define BEARING_OFFSET 0
+#endif
+
+/*! \brief One bearing estimate, see bearing_poll(). */
+typedef struct bearing {
+	/* \brief Bearing, binary angle: 65536 = 360 degrees. */
+	uint16_t angle;
+	/* \brief Share of the audio power in the Doppler tone, in percent. */
+	uint8_t quality;
+	/* \brief Rotations lost because they were not processed in time. */
+	uint8_t overruns;
+} bearing_t;
+
+bool bearing_init(void);
+bool bearing_poll(bearing_t *bearing);
+
+#endif
@@ -85,6 +85,11 @@ void CCPWrite( volatile uint8_t * address, uint8_t value )
 	    "out  0x34, r16  \n"
 	    "st     Z,  r18  \n");
 
+#elif defined HOST
+	/* register model of the host build, see host/avr/io.h */
+	CCP = CCP_IOREG_gc;
+	*address = value;
+
 #elif defined __GNUC__
 	volatile uint8_t * tmpAddr = address;
 #ifdef RAMPZ
@@ -0,0 +1,160 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "avr_compiler.h"
+#include "clksys_driver.h"
+#include "clock.h"
+
+/* Where the switch to the crystal PLL is. */
+typedef enum clock_state {
+	CLOCK_WAIT_XOSC,
+	CLOCK_WAIT_PLL,
+	CLOCK_DONE,
+	CLOCK_FAILED,
+} clock_state_t;
+
+static volatile clock_state_t state;
+static volatile clock_source_t source;
+/* Source changes and how many clock_poll() reported: counted instead of a
+ * flag because the NMI cannot be held off while clock_poll() clears it. */
+static volatile uint8_t changes;
+static uint8_t reported;
+/* the DFLL waits for the 32 kHz RC */
+static volatile bool calibrate;
+
+/* 16 MHz crystal, 16K cycles start-up, PLL times 2. */
+static void StartCrystal(void)
+{
+	CLKSYS_XOSC_Config(OSC_FRQRANGE_12TO16_gc, 0, OSC_XOSCSEL_XTAL_16KCLK_gc);
+	CLKSYS_Enable(OSC_XOSCEN_bm);
+}
+
+static void StartPll(void)
+{
+	CLKSYS_PLL_Config(OSC_PLLSRC_XOSC_gc, 2);
+	CLKSYS_Enable(OSC_PLLEN_bm);
+}
+
+/* The RC32M is ready a few microseconds after it is enabled, the DFLL
+ * calibrates it once the 32 kHz RC is running, see clock_poll(). */
+static void SelectRc(void)
+{
+	CLKSYS_Enable(OSC_RC32MEN_bm | OSC_RC32KEN_bm);
+	do {} while (CLKSYS_IsReady(OSC_RC32MRDY_bm) == 0);
+	CLKSYS_Main_ClockSource_Select(CLK_SCLKSEL_RC32M_gc);
+	CLKSYS_Disable(OSC_RC2MEN_bm);
+	source = CLOCK_RC32M;
+	calibrate = true;
+}
+
+/* The clock system switches without a glitch, the RCs are not needed after.
+ * From now on a crystal failure raises the NMI below. */
+static void SelectPll(void)
+{
+	CLKSYS_Main_ClockSource_Select(CLK_SCLKSEL_PLL_gc);
+	CLKSYS_AutoCalibration_Disable(DFLLRC32M);
+	CLKSYS_Disable(OSC_RC2MEN_bm | OSC_RC32MEN_bm | OSC_RC32KEN_bm);
+	source = CLOCK_PLL;
+	calibrate = false;
+	state = CLOCK_DONE;
+	CLKSYS_XOSC_FailureDetection_Enable();
+}
+
+/*! \brief Set up the 32 MHz system clock, call first thing in main().
+ *
+ *  With CLOCK_FAST_BOOT the CPU runs from the internal 32 MHz RC a few
+ *  microseconds after the call and the crystal starts in the background;
+ *  call clock_poll() from the main loop to calibrate the RC and to switch
+ *  over. Without, it waits for the crystal and the PLL lock like before.
+ *  Either way a crystal failure after the switch is caught, see
+ *  ISR(OSC_OSCF_vect).
+ */
+void clock_init(void)
+{
+#if CLOCK_FAST_BOOT
+	SelectRc();
+	StartCrystal();
+	state = CLOCK_WAIT_XOSC;
+#else
+	StartCrystal();
+	do {} while (CLKSYS_IsReady(OSC_XOSCRDY_bm) == 0);
+	StartPll();
+	do {} while (CLKSYS_IsReady(OSC_PLLRDY_bm) == 0);
+	SelectPll();
+#endif
+}
+
+/*! \brief Calibrate the RC and move the system clock to the crystal PLL
+ *         once it is ready, call from the main loop.
+ *
+ *  Never waits. Both clocks run at F_CPU, so the timer and baud rate
+ *  settings stay valid; the rotation rate is only as exact as the RC while
+ *  that runs.
+ *
+ *  \retval true   the system clock changed since the last call, see
+ *                 clock_source(): to the PLL, or back to the RC because
+ *                 the crystal failed
+ *  \retval false  no change
+ */
+bool clock_poll(void)
+{
+	if (calibrate && CLKSYS_IsReady(OSC_RC32KRDY_bm))
+	{
+		CLKSYS_AutoCalibration_Enable(OSC_RC32MCREF0_bm, false);
+		calibrate = false;
+	}
+
+	switch (state)
+	{
+	case CLOCK_WAIT_XOSC:
+		if (CLKSYS_IsReady(OSC_XOSCRDY_bm))
+		{
+			StartPll();
+			state = CLOCK_WAIT_PLL;
+		}
+		break;
+
+	case CLOCK_WAIT_PLL:
+		if (CLKSYS_IsReady(OSC_PLLRDY_bm))
+		{
+			SelectPll();
+			changes++;
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	if (changes == reported)
+		return false;
+	reported = changes;
+	return true;
+}
+
+/*! \brief The clock the CPU and the peripherals run from now. */
+clock_source_t clock_source(void)
+{
+	return source;
+}
+
+/* Crystal failure: the hardware has switched to the 2 MHz RC and stopped the
+ * PLL. Back to 32 MHz on the RC32M within microseconds, so TCC0 and the
+ * USART keep their settings and the commutation carries on from the antenna
+ * it was at. The crystal is not tried again until reset. */
+ISR(OSC_OSCF_vect)
+{
+	SelectRc();
+	CLKSYS_Disable(OSC_PLLEN_bm | OSC_XOSCEN_bm);
+	CCPWrite(&OSC.XOSCFAIL, OSC_XOSCFDIF_bm | OSC_XOSCFDEN_bm);
+	state = CLOCK_FAILED;
+	changes++;
+}
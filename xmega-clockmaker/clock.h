@@ -0,0 +1,34 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include "avr_compiler.h"
+
+/*! \brief 1: run from the internal 32 MHz RC right after reset and switch to
+ *         the crystal PLL when it is locked (clock_poll), 0: wait for the
+ *         crystal and the PLL in clock_init().
+ */
+#ifndef CLOCK_FAST_BOOT
+#define CLOCK_FAST_BOOT 1
+#endif
+
+/*! \brief Source of the 32 MHz system clock. */
+typedef enum clock_source {
+	/* \brief Internal 32 MHz RC, DFLL calibrated on the internal 32.768 kHz RC. */
+	CLOCK_RC32M,
+	/* \brief 16 MHz crystal times 2 in the PLL. */
+	CLOCK_PLL,
+} clock_source_t;
+
+void clock_init(void);
+bool clock_poll(void);
+clock_source_t clock_source(void);
+
+#endif
@@ -0,0 +1,934 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <stdlib.h>
+
+#include "avr_compiler.h"
+#include "antennas.h"
+#include "commutation.h"
+#include "log.h"
+#include "timebase.h"
+#include "load.h"
+
+/* Width of the debug pulse on PC0 (OC0A) at the start of every step. */
+#define DEBUG_PULSE_US 1000UL
+
+/* The NCO increment is kept as inc + rem / NCO_DEN per tick, exact to the mHz. */
+#define NCO_DEN (NCO_TICK_HZ * 1000UL)
+
+/* AWEX dead time in clkPER cycles. */
+#define AWEX_DEAD_TIME_CYCLES (AWEX_DEAD_TIME_NS * (F_CPU / 1000000UL) / 1000UL)
+/* Compare values that keep a select line low or high, see commutation_plan(). */
+#define AWEX_LINE_OFF 0x0000
+#define AWEX_LINE_ON  0xFFFF
+
+/* DAC samples per rotation of COMMUTATION_MODE_CROSSFADE, largest array. */
+#define CROSSFADE_LENGTH (ANTENNA_COUNT_MAX * CROSSFADE_SAMPLES)
+/* Bias of the antenna that is on. */
+#define CROSSFADE_FULL 4095
+/* PORTD value that routes DAC CH0 to antenna even and CH1 to antenna odd. */
+#define CROSSFADE_ROUTE(even, odd) (((even) >> 1) | (((odd) >> 1) << 4))
+
+/* DAC CH1 level that marks the start of rotation f, 0 with the codes off. */
+#define FRAME_CODE(f) (frame_codes ? FRAME_CODE_LEVEL((f) & (FRAME_CODE_COUNT - 1)) : 0)
+
+/* Divider per TC_CLKSEL_DIVn_gc value. */
+static const uint16_t tc_div[] = { 0, 1, 2, 4, 8, 64, 256, 1024 };
+
+/* Raised cosine fade-in, (1 - cos(pi (j + 0.5) / 8)) / 2 of CROSSFADE_FULL.
+ * Read backwards it is the fade-out, the two always add up to CROSSFADE_FULL. */
+static const uint16_t crossfade_in[CROSSFADE_FADE_SAMPLES] PROGMEM = {
+	39, 345, 910, 1648, 2447, 3185, 3750, 4056
+};
+
+static commutation_mode_t commutation_mode;
+/* Steps made by DMA CH0, rotation start signalled by its block interrupt. */
+static bool dma_driven;
+
+/* Array in use, the pattern tables are in flash. */
+static const antenna_table_t *active;
+static const uint8_t *active_port;
+static const uint16_t *active_dac;
+static uint8_t step_mask;
+static uint8_t step;
+/* Frame number of the next rotation start, counted up in the last step of
+ * every rotation (the tick before the start in COMMUTATION_MODE_NCO). */
+static uint8_t frame;
+/* Frame codes on DACB CH1, see commutation_frame_codes(). */
+static volatile bool frame_codes = true;
+
+/* The DMA cannot read flash, it streams copies of the tables from SRAM. Two
+ * banks, the next array is copied in while the other one is streamed. The
+ * modes share the memory, the crossfade banks (2.5 kB) are only there with
+ * COMMUTATION_CROSSFADE. */
+static union {
+	/* one entry per step */
+	struct {
+		uint8_t port[ANTENNA_COUNT_MAX];
+		/* DAC CH0 marker level and CH1 frame code */
+		uint16_t dac[ANTENNA_COUNT_MAX][2];
+		/* COMMUTATION_MODE_AWEX: TCC0 CCABUF-CCDBUF, one line on */
+		uint16_t awex[AWEX_ANTENNA_MAX][4];
+	} step[2];
+#if COMMUTATION_CROSSFADE
+	/* COMMUTATION_MODE_CROSSFADE: one entry per DAC sample */
+	struct {
+		uint8_t port[CROSSFADE_LENGTH];
+		uint16_t dac[CROSSFADE_LENGTH][2];
+	} fade[2];
+#endif
+} dma_banks;
+static uint8_t dma_bank;
+
+/* Phase accumulator of COMMUTATION_MODE_NCO, a full turn is one rotation.
+ * nco_phase is the last tick; the next tick, its remainder, antenna and
+ * port pattern are worked out one tick ahead. */
+static uint32_t nco_phase;
+static uint32_t nco_ahead;
+static uint32_t nco_frac;
+static uint8_t nco_next;
+static uint8_t nco_port;
+static uint32_t nco_inc;
+static uint32_t nco_rem;
+
+/* Plan handed to commutation_apply(), taken over at the next rotation start. */
+static commutation_plan_t pending_plan;
+static volatile bool plan_pending;
+static uint8_t active_clksel;
+static uint16_t active_per;
+
+/* Period trim of commutation_trim() in 1/65536 timer ticks per event, the
+ * fraction is carried from rotation to rotation. trim_cycles is the trim as
+ * given, trim_scale the CPU cycles of a tick on every event of a rotation of
+ * the plan the next PERBUF is for; a plan switch works trim out again. */
+static volatile int32_t trim;
+static int32_t trim_frac;
+static volatile int32_t trim_cycles;
+static volatile int32_t trim_scale;
+/* Prescaler to select right after the next rotation start, OFF for none. */
+static uint8_t switch_clksel;
+
+/* Timer kept in step lock by commutation_lock_timer(), NULL for none. */
+static TC0_t *lock_tc;
+static uint8_t lock_per_rotation;
+/* (Re)start the locked timer at the next rotation start. */
+static volatile bool lock_start;
+
+/* PORTD pins the mode drives for an array. */
+static uint8_t PortPins(const antenna_table_t *table)
+{
+	uint8_t half = (table->count >> 1) - 1;
+
+	if (commutation_mode == COMMUTATION_MODE_AWEX)
+		return 0;
+	if (commutation_mode == COMMUTATION_MODE_CROSSFADE)
+		return CROSSFADE_ROUTE(half << 1, half << 1);
+	return table->pins;
+}
+
+static void UseTable(const antenna_table_t *table)
+{
+	active = table;
+	active_port = table->port;
+	active_dac = table->dac;
+	step_mask = table->count - 1;
+	PORTD.DIRSET = PortPins(table);
+}
+
+/* TCC0 overflows per rotation. */
+static uint16_t EventsPerRotation(void)
+{
+	if (commutation_mode == COMMUTATION_MODE_CROSSFADE)
+		return (uint16_t)active->count * CROSSFADE_SAMPLES;
+	return active->count;
+}
+
+#if COMMUTATION_CROSSFADE
+/* Crossfade waveform of one rotation. Antenna k is biased by DAC CH(k & 1).
+ * A step starts with CROSSFADE_FADE_SAMPLES of raised cosine from antenna
+ * k - 1 to k, after that k is on alone. The idle channel is routed on to
+ * antenna k + 1 one sample after it reached zero, so the routing never
+ * switches a biased diode. */
+static void BuildCrossfade(uint8_t count, uint8_t bank)
+{
+	uint8_t mask = count - 1;
+	uint16_t length = (uint16_t)count * CROSSFADE_SAMPLES;
+	uint16_t n = 0;
+
+	for (uint8_t k = 0; k < count; ++k)
+	{
+		uint8_t on_ch = k & 1;
+
+		for (uint8_t j = 0; j < CROSSFADE_SAMPLES; ++j, ++n)
+		{
+			uint16_t on = CROSSFADE_FULL;
+			uint16_t off = 0;
+			uint8_t other = (k + 1) & mask;
+			/* the DAC stream is loaded a sample ahead, like the step tables */
+			uint16_t *dac = dma_banks.fade[bank].dac[(n + length - 1) % length];
+
+			if (j < CROSSFADE_FADE_SAMPLES)
+			{
+				on = pgm_read_word(&crossfade_in[j]);
+				off = pgm_read_word(&crossfade_in[CROSSFADE_FADE_SAMPLES - 1 - j]);
+			}
+			if (j <= CROSSFADE_FADE_SAMPLES)
+				other = (k - 1) & mask;
+
+			dma_banks.fade[bank].port[n] = on_ch ? CROSSFADE_ROUTE(other, k) : CROSSFADE_ROUTE(k, other);
+			dac[on_ch] = on;
+			dac[on_ch ^ 1] = off;
+		}
+	}
+}
+#endif
+
+static void CopyTable(const antenna_table_t *table, uint8_t bank)
+{
+#if COMMUTATION_CROSSFADE
+	if (commutation_mode == COMMUTATION_MODE_CROSSFADE)
+	{
+		BuildCrossfade(table->count, bank);
+		return;
+	}
+#endif
+
+	/* the frame code goes in with QueueFrameCode() */
+	for (uint8_t i = 0; i < table->count; ++i)
+	{
+		dma_banks.step[bank].dac[i][0] = pgm_read_word(&table->dac[i]);
+		dma_banks.step[bank].dac[i][1] = 0;
+	}
+
+	if (commutation_mode != COMMUTATION_MODE_AWEX)
+	{
+		memcpy_P(dma_banks.step[bank].port, table->port, table->count);
+		return;
+	}
+
+	/* loaded a step ahead like the DAC, so entry i turns on antenna i + 1 */
+	for (uint8_t i = 0; i < table->count; ++i)
+	{
+		uint8_t next = (i + 1) & (table->count - 1);
+
+		for (uint8_t line = 0; line < 4; ++line)
+			dma_banks.step[bank].awex[i][line] = (line == next) ? AWEX_LINE_ON : AWEX_LINE_OFF;
+	}
+}
+
+/* DAC value(s) of the first event of a rotation, the same for every array. */
+static void LoadStartLevel(void)
+{
+	if (commutation_mode == COMMUTATION_MODE_CROSSFADE)
+	{
+		/* antenna 0 on CH0 fades in, the last antenna on CH1 fades out */
+		DACB.CH0DATA = pgm_read_word(&crossfade_in[0]);
+		DACB.CH1DATA = pgm_read_word(&crossfade_in[CROSSFADE_FADE_SAMPLES - 1]);
+	}
+	else
+	{
+		DACB.CH0DATA = pgm_read_word(&active_dac[step_mask]);
+		DACB.CH1DATA = FRAME_CODE(frame);
+	}
+}
+
+/* Frame code of the rotation start after the next into the DMA stream, the
+ * entry for the next one has been loaded into the DAC already. */
+static void QueueFrameCode(void)
+{
+	if (commutation_mode == COMMUTATION_MODE_DMA || commutation_mode == COMMUTATION_MODE_AWEX)
+		dma_banks.step[dma_bank].dac[step_mask][1] = FRAME_CODE(frame + 1);
+}
+
+/*! \brief Let a DMA channel repeat one block forever, one burst per trigger.
+ *
+ *  \param  ch        DMA channel to use
+ *  \param  src       source table in SRAM (the DMA cannot read flash)
+ *  \param  dest      destination register
+ *  \param  size      block size in bytes (whole table)
+ *  \param  burstLen  bytes per trigger, DMA_CH_BURSTLEN_t
+ *  \param  addrCtrl  address reload and direction, DMA_CH_*RELOAD/DIR_gc
+ *  \param  trigSrc   trigger source, DMA_CH_TRIGSRC_t
+ */
+static void DmaStream(DMA_CH_t *ch, const void *src, volatile void *dest,
+                      uint16_t size, uint8_t burstLen, uint8_t addrCtrl, uint8_t trigSrc)
+{
+	ch->CTRLA = 0;
+	ch->CTRLA = DMA_CH_RESET_bm;
+
+	ch->ADDRCTRL = addrCtrl;
+	ch->TRIGSRC = trigSrc;
+	ch->TRFCNT = size;
+	ch->REPCNT = 0; /* with REPEAT set: repeat forever */
+
+	ch->SRCADDR0 = (uint8_t)((uint16_t)src);
+	ch->SRCADDR1 = (uint8_t)((uint16_t)src >> 8);
+	ch->SRCADDR2 = 0;
+	ch->DESTADDR0 = (uint8_t)((uint16_t)dest);
+	ch->DESTADDR1 = (uint8_t)((uint16_t)dest >> 8);
+	ch->DESTADDR2 = 0;
+
+	ch->CTRLA = DMA_CH_ENABLE_bm | DMA_CH_REPEAT_bm | DMA_CH_SINGLE_bm | burstLen;
+}
+
+/* (Re)start both streams on a bank, the next trigger takes entry 0. */
+static void StartDmaStreams(uint8_t bank, uint8_t count)
+{
+#if COMMUTATION_CROSSFADE
+	if (commutation_mode == COMMUTATION_MODE_CROSSFADE)
+	{
+		uint16_t length = (uint16_t)count * CROSSFADE_SAMPLES;
+
+		/* bias routing, one byte per sample */
+		DmaStream(&DMA.CH0, dma_banks.fade[bank].port, &PORTD.OUT, length,
+		          DMA_CH_BURSTLEN_1BYTE_gc,
+		          DMA_CH_SRCRELOAD_BLOCK_gc | DMA_CH_SRCDIR_INC_gc |
+		          DMA_CH_DESTRELOAD_NONE_gc | DMA_CH_DESTDIR_FIXED_gc,
+		          DMA_CH_TRIGSRC_EVSYS_CH0_gc);
+		DMA.CH0.CTRLB = DMA_CH_TRNINTLVL_LO_gc;
+
+		/* both bias levels, CH0DATA and CH1DATA in one burst */
+		DmaStream(&DMA.CH1, dma_banks.fade[bank].dac, &DACB.CH0DATA, length * sizeof(dma_banks.fade[0].dac[0]),
+		          DMA_CH_BURSTLEN_4BYTE_gc,
+		          DMA_CH_SRCRELOAD_BLOCK_gc | DMA_CH_SRCDIR_INC_gc |
+		          DMA_CH_DESTRELOAD_BURST_gc | DMA_CH_DESTDIR_INC_gc,
+		          DMA_CH_TRIGSRC_DACB_CH0_gc);
+		return;
+	}
+#endif
+
+	if (commutation_mode == COMMUTATION_MODE_AWEX)
+	{
+		/* compare buffers of the next step, CCABUF to CCDBUF */
+		DmaStream(&DMA.CH0, dma_banks.step[bank].awex, &TCC0.CCABUF, count * sizeof(dma_banks.step[0].awex[0]),
+		          DMA_CH_BURSTLEN_8BYTE_gc,
+		          DMA_CH_SRCRELOAD_BLOCK_gc | DMA_CH_SRCDIR_INC_gc |
+		          DMA_CH_DESTRELOAD_BURST_gc | DMA_CH_DESTDIR_INC_gc,
+		          DMA_CH_TRIGSRC_EVSYS_CH0_gc);
+	}
+	else
+	{
+		/* antenna select, one byte per step */
+		DmaStream(&DMA.CH0, dma_banks.step[bank].port, &PORTD.OUT, count,
+		          DMA_CH_BURSTLEN_1BYTE_gc,
+		          DMA_CH_SRCRELOAD_BLOCK_gc | DMA_CH_SRCDIR_INC_gc |
+		          DMA_CH_DESTRELOAD_NONE_gc | DMA_CH_DESTDIR_FIXED_gc,
+		          DMA_CH_TRIGSRC_EVSYS_CH0_gc);
+	}
+	/* block complete = start of the last step of a rotation */
+	DMA.CH0.CTRLB = DMA_CH_TRNINTLVL_LO_gc;
+
+	/* marker level and frame code, loaded as soon as the DAC has converted the
+	 * previous pair */
+	DmaStream(&DMA.CH1, dma_banks.step[bank].dac, &DACB.CH0DATA, count * sizeof(dma_banks.step[0].dac[0]),
+	          DMA_CH_BURSTLEN_4BYTE_gc,
+	          DMA_CH_SRCRELOAD_BLOCK_gc | DMA_CH_SRCDIR_INC_gc |
+	          DMA_CH_DESTRELOAD_BURST_gc | DMA_CH_DESTDIR_INC_gc,
+	          DMA_CH_TRIGSRC_DACB_CH0_gc);
+}
+
+/* Select line of antenna i on PC(2 i), the low side output of compare channel
+ * i. Dead-time insertion delays every rising edge, falling edges are not
+ * delayed, so the line that was on is always off before the next comes on. */
+static void InitAwex(uint8_t count)
+{
+	uint8_t channels = (1 << count) - 1;
+	uint8_t lines = 0;
+
+	for (uint8_t i = 0; i < count; ++i)
+		lines |= 1 << (2 * i);
+
+	PORTC.OUTCLR = lines;
+	PORTC.DIRSET = lines;
+
+	/* all lines off until the first overflow loads antenna 0 */
+	TCC0.CCA = AWEX_LINE_OFF;
+	TCC0.CCB = AWEX_LINE_OFF;
+	TCC0.CCC = AWEX_LINE_OFF;
+	TCC0.CCD = AWEX_LINE_OFF;
+	TCC0.CCABUF = AWEX_LINE_ON;
+	TCC0.CCBBUF = AWEX_LINE_OFF;
+	TCC0.CCCBUF = AWEX_LINE_OFF;
+	TCC0.CCDBUF = AWEX_LINE_OFF;
+
+	AWEXC.DTLS = AWEX_DEAD_TIME_CYCLES;
+	AWEXC.DTHS = 0;
+	AWEXC.CTRL = channels; /* AWEX_DTICCnEN_bm */
+	AWEXC.OUTOVEN = lines;
+	TCC0.CTRLB = (channels << 4) | TC_WGMODE_SS_gc; /* TC0_CCnEN_bm */
+}
+
+/*! \brief Work out the settings for a rotation frequency.
+ *
+ *  For the timer modes every TCC0 prescaler is tried and the one whose
+ *  rounded period gives the smallest frequency error is kept. On a tie the
+ *  smaller prescaler wins, it leaves finer steps for the next change.
+ *
+ *  For COMMUTATION_MODE_NCO TCC0 ticks at NCO_TICK_HZ and the phase increment
+ *  is split in a whole part and a remainder, so the rotation frequency is
+ *  exact and the phase does not drift. A step has to last at least 2 ticks.
+ *
+ *  In COMMUTATION_MODE_CROSSFADE TCC0 overflows CROSSFADE_SAMPLES times per
+ *  step, so the sample rate sets the lower bound of the period.
+ *
+ *  COMMUTATION_MODE_AWEX keeps PER below 0xFFFF, a compare value of 0xFFFF
+ *  then never matches and holds a select line high for the whole step.
+ *
+ *  \param  mode          commutation mode the plan is for
+ *  \param  f_cpu         clock of TCC0 in Hz
+ *  \param  rotation_mhz  wanted rotation frequency (all antennas) in mHz
+ *  \param  antennas      number of antennas, one of the arrays in antennas.c
+ *  \param  plan          result, untouched when false is returned
+ *
+ *  \retval true   plan is filled in
+ *  \retval false  the frequency or array can not be made in this mode, or
+ *                 the mode is not built in (COMMUTATION_CROSSFADE)
+ */
+bool commutation_plan(commutation_mode_t mode, uint32_t f_cpu,
+                      uint32_t rotation_mhz, uint8_t antennas, commutation_plan_t *plan)
+{
+	bool found = false;
+	int32_t best_error = 0;
+	/* TCC0 overflows per rotation */
+	uint16_t events = antennas;
+
+	if (mode == COMMUTATION_MODE_CROSSFADE)
+		events *= CROSSFADE_SAMPLES;
+	if (rotation_mhz == 0 || antenna_table(antennas) == NULL)
+		return false;
+	if (mode == COMMUTATION_MODE_AWEX && antennas > AWEX_ANTENNA_MAX)
+		return false;
+	if (mode == COMMUTATION_MODE_CROSSFADE && !COMMUTATION_CROSSFADE)
+		return false;
+
+	if (mode == COMMUTATION_MODE_NCO)
+	{
+		uint64_t turn = (uint64_t)rotation_mhz << 32;
+
+		if (f_cpu % NCO_TICK_HZ || (uint64_t)rotation_mhz * antennas * 2 > NCO_DEN)
+			return false;
+
+		plan->nco_inc = turn / NCO_DEN;
+		plan->nco_rem = turn % NCO_DEN;
+		plan->clksel = TC_CLKSEL_DIV1_gc;
+		plan->per = f_cpu / NCO_TICK_HZ - 1;
+		plan->pulse = 0;
+		plan->antennas = antennas;
+		plan->achieved_mhz = rotation_mhz;
+		plan->error_ppm = 0;
+		return true;
+	}
+
+	for (uint8_t clksel = TC_CLKSEL_DIV1_gc; clksel <= TC_CLKSEL_DIV1024_gc; ++clksel)
+	{
+		/* period in ticks is f_cpu * 1000 / (rotation_mhz * events * div) */
+		uint64_t num = (uint64_t)f_cpu * 1000;
+		uint64_t den = (uint64_t)rotation_mhz * events * tc_div[clksel];
+		uint32_t ticks = (num + den / 2) / den;
+		uint32_t max_ticks = (mode == COMMUTATION_MODE_AWEX) ? AWEX_LINE_ON : 0x10000UL;
+
+		if (ticks > max_ticks || ticks * tc_div[clksel] < COMMUTATION_MIN_STEP_CYCLES)
+			continue;
+
+		uint64_t made = den * ticks;
+		uint64_t cycles = (uint64_t)events * tc_div[clksel] * ticks;
+		int32_t error = ((int64_t)num - (int64_t)made) * 1000000 / (int64_t)made;
+
+		if (!found || labs(error) < labs(best_error))
+		{
+			uint32_t pulse = f_cpu / tc_div[clksel] / (1000000UL / DEBUG_PULSE_US);
+
+			if (pulse > ticks / 2)
+				pulse = ticks / 2;
+			if (mode == COMMUTATION_MODE_AWEX)
+				pulse = 0; /* compare channel A is antenna 0 */
+
+			plan->clksel = clksel;
+			plan->per = ticks - 1;
+			plan->pulse = pulse;
+			plan->antennas = antennas;
+			plan->achieved_mhz = (num + cycles / 2) / cycles;
+			plan->error_ppm = error;
+			best_error = error;
+			found = true;
+		}
+	}
+	return found;
+}
+
+/*! \brief Start antenna commutation on TCC0.
+ *
+ *  PORTD selects the antenna (see antennas.h), DACB CH0 (PB2) outputs a
+ *  staircase the flowgraph syncs on. Every TCC0 overflow starts the next step.
+ *  TCC0 runs in single slope mode so compare channel A drives a debug pulse
+ *  on PC0 in hardware: set at the step edge, cleared plan->pulse ticks later.
+ *  In COMMUTATION_MODE_NCO TCC0 is the accumulator tick and the DAC converts
+ *  on every tick, PC0 is left alone. In COMMUTATION_MODE_AWEX the compare
+ *  channels drive the select lines on PORTC instead, PORTD is not used. In
+ *  COMMUTATION_MODE_CROSSFADE both DAC channels bias the antennas, there is
+ *  no sync marker.
+ *
+ *  \param  mode  one of commutation_mode_t
+ *  \param  plan  timer settings from commutation_plan()
+ */
+void commutation_init(commutation_mode_t mode, const commutation_plan_t *plan)
+{
+	const antenna_table_t *table = antenna_table(plan->antennas);
+
+	commutation_mode = mode;
+	frame = 0;
+	frame_codes = true;
+	dma_driven = (mode == COMMUTATION_MODE_DMA || mode == COMMUTATION_MODE_AWEX ||
+	              mode == COMMUTATION_MODE_CROSSFADE);
+	step = 0;
+	nco_phase = 0;
+	nco_inc = plan->nco_inc;
+	nco_rem = plan->nco_rem;
+	plan_pending = false;
+	switch_clksel = TC_CLKSEL_OFF_gc;
+	trim = 0;
+	trim_frac = 0;
+	trim_cycles = 0;
+	lock_tc = NULL;
+	lock_start = false;
+
+	PORTD.OUTCLR = PortPins(table);
+	UseTable(table);
+	/* the first tick, rem < NCO_DEN so it gets no carry */
+	nco_ahead = nco_inc;
+	nco_frac = nco_rem;
+	nco_next = 0;
+	nco_port = pgm_read_byte(&active_port[0]);
+
+	PORTB.PIN2CTRL = PORT_ISC_INPUT_DISABLE_gc; /* DAC output; turn off input buffer (may or may not do much good) */
+	PORTB.PIN3CTRL = PORT_ISC_INPUT_DISABLE_gc;
+
+	/* the DAC holds both outputs with sample and hold, keep them refreshed */
+	DACB.CTRLA = DAC_CH1EN_bm | DAC_CH0EN_bm | DAC_ENABLE_bm;
+	DACB.CTRLB = DAC_CHSEL_DUAL_gc | DAC_CH1TRIG_bm | DAC_CH0TRIG_bm;
+	DACB.TIMCTRL = DAC_CONINTVAL_32CLK_gc | DAC_REFRESH_256CLK_gc;
+	DACB.CTRLC = DAC_REFSEL_AVCC_gc;
+	DACB.EVCTRL = DAC_EVSEL_0_gc;
+	/* converted on the first event */
+	LoadStartLevel();
+
+	EVSYS.CH0MUX = EVSYS_CHMUX_TCC0_OVF_gc;
+
+	if (dma_driven)
+	{
+		DMA.CTRL = 0;
+		DMA.CTRL = DMA_RESET_bm;
+		DMA.CTRL = DMA_ENABLE_bm | DMA_PRIMODE_CH01RR23_gc;
+
+		dma_bank = 0;
+		CopyTable(table, dma_bank);
+		QueueFrameCode();
+		StartDmaStreams(dma_bank, table->count);
+		TCC0.INTCTRLA = TC_OVFINTLVL_OFF_gc;
+	}
+	else if (mode == COMMUTATION_MODE_NCO)
+	{
+		/* a tick served late is fine, a tick lost is phase drift */
+		TCC0.INTCTRLA = TC_OVFINTLVL_MED_gc;
+	}
+	else
+	{
+		TCC0.INTCTRLA = TC_OVFINTLVL_LO_gc;
+	}
+
+	if (mode == COMMUTATION_MODE_NCO)
+	{
+		TCC0.CTRLB = TC_WGMODE_NORMAL_gc;
+	}
+	else if (mode == COMMUTATION_MODE_AWEX)
+	{
+		InitAwex(table->count);
+	}
+	else
+	{
+		PORTC.DIRSET = PIN0_bm;
+		TCC0.CTRLB = TC0_CCAEN_bm | TC_WGMODE_SS_gc;
+	}
+	TCC0.CTRLD = TC_EVACT_OFF_gc | TC_EVSEL_OFF_gc;
+	TCC0.PER = plan->per;
+	if (mode != COMMUTATION_MODE_AWEX)
+		TCC0.CCA = plan->pulse;
+	active_per = plan->per;
+	active_clksel = plan->clksel;
+	trim_scale = (int32_t)EventsPerRotation() * tc_div[plan->clksel];
+	TCC0.CTRLA = plan->clksel;
+}
+
+/*! \brief Change the rotation frequency and array at the next rotation start.
+ *
+ *  The period goes through PERBUF, so the hardware swaps it exactly at the
+ *  overflow that starts antenna 0. A different prescaler is selected right
+ *  after that overflow, the ticks already counted are rescaled to the new
+ *  prescaler so the first step keeps its length. In COMMUTATION_MODE_NCO the
+ *  table and the increment are swapped a tick ahead, when the accumulator
+ *  is found to wrap on the next tick, so that tick already shows antenna 0
+ *  of the new plan. A different antenna count takes effect at the same
+ *  moment.
+ *
+ *  \param  plan  settings from commutation_plan() for the running mode
+ */
+void commutation_apply(const commutation_plan_t *plan)
+{
+	/* the spare DMA bank is only free while nothing is pending */
+	plan_pending = false;
+	if (dma_driven)
+		CopyTable(antenna_table(plan->antennas), dma_bank ^ 1);
+
+	AVR_ENTER_CRITICAL_REGION();
+	pending_plan = *plan;
+	plan_pending = true;
+	AVR_LEAVE_CRITICAL_REGION();
+}
+
+/* Period of the locked timer for TCC0 period per. Its overflows stay inside
+ * the step, so an overflow never races the restart at the step edge. */
+static bool LockPeriod(uint16_t per, uint8_t per_rotation, uint16_t *lock_per)
+{
+	uint16_t events = EventsPerRotation();
+	uint8_t divider;
+	uint16_t ticks;
+
+	if (per_rotation < events || per_rotation % events)
+		return false;
+	divider = per_rotation / events;
+	ticks = per / divider;
+	if (ticks < 2 || (uint32_t)ticks * (divider + 1) <= (uint32_t)per + 1)
+		return false;
+
+	*lock_per = ticks - 1;
+	return true;
+}
+
+/*! \brief Run a spare timer in lock with the antenna steps.
+ *
+ *  The timer overflows \em per_rotation times per rotation, at the same
+ *  places in every step: it gets the prescaler of TCC0, is restarted by
+ *  every step edge on event channel 0 and is started at the next rotation
+ *  start with the ticks TCC0 has counted since. Its overflow can trigger an
+ *  ADC or DMA in sync with the antennas. It is locked again whenever a new
+ *  plan takes effect, and stays off (with a log record) while \em per_rotation
+ *  is not a multiple of the steps per rotation or the step is too short for
+ *  it.
+ *
+ *  Call after commutation_init().
+ *
+ *  \param  tc            timer to lock, not TCC0
+ *  \param  per_rotation  overflows per rotation
+ *
+ *  \retval true   the timer starts at the next rotation start
+ *  \retval false  COMMUTATION_MODE_NCO has no steps to lock to, or the
+ *                 running plan can not carry the lock
+ */
+bool commutation_lock_timer(TC0_t *tc, uint8_t per_rotation)
+{
+	uint16_t per;
+
+	if (commutation_mode == COMMUTATION_MODE_NCO || !LockPeriod(active_per, per_rotation, &per))
+		return false;
+
+	tc->CTRLA = TC_CLKSEL_OFF_gc;
+	tc->CTRLB = TC_WGMODE_NORMAL_gc;
+	tc->CTRLD = TC_EVACT_RESTART_gc | TC_EVSEL_CH0_gc;
+
+	AVR_ENTER_CRITICAL_REGION();
+	lock_tc = tc;
+	lock_per_rotation = per_rotation;
+	lock_start = true;
+	AVR_LEAVE_CRITICAL_REGION();
+	return true;
+}
+
+/* Store a trim worked out at scale, unless a plan switch has changed the
+ * scale since: it has then worked the trim out of trim_cycles itself. */
+static void StoreTrim(int32_t per_event, int32_t scale)
+{
+	AVR_ENTER_CRITICAL_REGION();
+	if (scale == trim_scale)
+		trim = per_event;
+	AVR_LEAVE_CRITICAL_REGION();
+}
+
+/*! \brief Lengthen or shorten the rotations by a fraction of a cycle.
+ *
+ *  From the next rotation start every rotation takes \em cycles / 65536
+ *  CPU cycles longer (shorter when negative) on average than the plan. The
+ *  period of all steps of a rotation is changed by the same whole number of
+ *  timer ticks, the remainder is carried to the next rotation, so the
+ *  rotation start is never more than a tick per step off the ideal. Stays
+ *  in effect for new plans, worked out again for their prescaler and
+ *  antenna count at the switch; commutation_init() clears it. Not available
+ *  in COMMUTATION_MODE_NCO, which has no steps to stretch.
+ *
+ *  \param  cycles  CPU cycles per rotation, in 1/65536
+ */
+void commutation_trim(int32_t cycles)
+{
+	int32_t scale;
+
+	AVR_ENTER_CRITICAL_REGION();
+	trim_cycles = cycles;
+	scale = trim_scale;
+	AVR_LEAVE_CRITICAL_REGION();
+
+	/* divided with interrupts on */
+	StoreTrim(cycles / scale, scale);
+}
+
+/*! \brief Number of the current rotation, modulo 256.
+ *
+ *  Counts up once per rotation, the frame code on DACB CH1 is
+ *  FRAME_CODE_LEVEL of it modulo FRAME_CODE_COUNT.
+ */
+uint8_t commutation_rotation(void)
+{
+	return *(volatile uint8_t *)&frame;
+}
+
+/*! \brief Switch the frame codes on DACB CH1 on or off.
+ *
+ *  Takes effect with the code of the next rotation start, CH1 stays 0 while
+ *  the codes are off. The staircase on CH0 is not affected.
+ *
+ *  \param  on  output the frame codes (default after commutation_init())
+ */
+void commutation_frame_codes(bool on)
+{
+	frame_codes = on;
+}
+
+/* Array of the pending plan, runs in the last step of a rotation. Antenna 0
+ * has the same marker level in every array, so the level already loaded for
+ * the rotation start stays valid. */
+static void SwitchTable(void)
+{
+	const antenna_table_t *table = antenna_table(pending_plan.antennas);
+
+	if (table == active)
+		return;
+
+	UseTable(table);
+	if (dma_driven)
+	{
+		DMA.CH1.CTRLA = 0;
+		/* CH1 may have been stopped before it loaded the rotation start */
+		if (DACB.STATUS & DAC_CH0DRE_bm)
+			LoadStartLevel();
+
+		dma_bank ^= 1;
+		StartDmaStreams(dma_bank, table->count);
+	}
+}
+
+/* Start the locked timer at the ticks TCC0 has counted since the rotation start. */
+static void LockTimer(void)
+{
+	uint16_t per;
+
+	lock_tc->CTRLA = TC_CLKSEL_OFF_gc;
+	if (!LockPeriod(TCC0.PER, lock_per_rotation, &per))
+	{
+		LOG("commutation: timer lock not possible, PER %u", TCC0.PER);
+		return;
+	}
+
+	lock_tc->PER = per;
+	lock_tc->CNT = TCC0.CNT;
+	lock_tc->CTRLA = active_clksel;
+}
+
+/* Runs at the start of the last step of a rotation. */
+static void RotationLastStep(void)
+{
+	frame++;
+	if (plan_pending)
+		SwitchTable();
+	QueueFrameCode();
+#if TIMEBASE
+	timebase_rotation(frame);
+#endif
+
+	if (plan_pending)
+	{
+		active_per = pending_plan.per;
+		if (commutation_mode != COMMUTATION_MODE_AWEX)
+			TCC0.CCABUF = pending_plan.pulse;
+		if (pending_plan.clksel != active_clksel)
+		{
+			switch_clksel = pending_plan.clksel;
+			/* under a tick, in ticks of the old prescaler */
+			trim_frac = 0;
+		}
+		/* the next rotation counts ticks of the new plan */
+		trim_scale = (int32_t)EventsPerRotation() * tc_div[pending_plan.clksel];
+		if (trim_cycles != 0)
+			trim = trim_cycles / trim_scale;
+		if (lock_tc)
+			lock_start = true;
+		plan_pending = false;
+		LOG("commutation: new plan from rotation %u, PER %u", (uint8_t)(frame + 1), pending_plan.per);
+	}
+
+	/* copied into PER/CCA by the overflow that starts the next rotation */
+	if (trim == 0 && trim_frac == 0)
+	{
+		TCC0.PERBUF = active_per;
+	}
+	else
+	{
+		int16_t ticks;
+
+		trim_frac += trim;
+		ticks = trim_frac >> 16;
+		trim_frac -= (int32_t)ticks << 16;
+		TCC0.PERBUF = active_per + ticks;
+	}
+
+	if (dma_driven && (switch_clksel != TC_CLKSEL_OFF_gc || lock_start))
+	{
+		/* one overflow interrupt, the flag is stale from the DMA steps */
+		TCC0.INTFLAGS = TC0_OVFIF_bm;
+		TCC0.INTCTRLA = TC_OVFINTLVL_LO_gc;
+	}
+}
+
+/* Runs right after the overflow that starts antenna 0. */
+static void RotationStart(void)
+{
+	if (switch_clksel != TC_CLKSEL_OFF_gc)
+	{
+		uint16_t cnt = TCC0.CNT;
+
+		TCC0.CTRLA = switch_clksel;
+		TCC0.CNT = (uint32_t)cnt * tc_div[active_clksel] / tc_div[switch_clksel];
+		active_clksel = switch_clksel;
+		switch_clksel = TC_CLKSEL_OFF_gc;
+	}
+
+	if (lock_start)
+	{
+		LockTimer();
+		lock_start = false;
+	}
+
+	if (dma_driven)
+		TCC0.INTCTRLA = TC_OVFINTLVL_OFF_gc;
+}
+
+/* Antenna for a phase: top byte times count, the index ends up in the high
+ * byte. One hardware multiply instead of a shift by a variable count. */
+static uint8_t NcoIndex(uint32_t phase)
+{
+	return ((uint16_t)(uint8_t)(phase >> 24) * active->count) >> 8;
+}
+
+/* One accumulator tick, the antenna changes when the top bits do. The
+ * outputs of a step are loaded on the tick before it, the other ticks only
+ * advance the accumulator. */
+static void NcoTick(void)
+{
+	uint32_t phase = nco_ahead;
+	uint32_t frac;
+	uint8_t index = nco_next;
+	uint8_t next;
+
+	PORTD.OUT = nco_port;
+	nco_phase = phase;
+
+	/* the next tick, including the carry it gets */
+	frac = nco_frac + nco_rem;
+	phase += nco_inc;
+	if (frac >= NCO_DEN)
+	{
+		frac -= NCO_DEN;
+		phase++;
+	}
+	nco_frac = frac;
+	nco_ahead = phase;
+	if (plan_pending && phase < nco_phase)
+	{
+		/* the next tick wraps: antenna 0 of the new plan starts on it, its
+		 * port and DAC values are loaded below like any other step */
+		SwitchTable();
+		nco_inc = pending_plan.nco_inc;
+		nco_rem = pending_plan.nco_rem;
+		plan_pending = false;
+		index = 0xFF;
+	}
+	next = NcoIndex(phase);
+	nco_next = next;
+	if (next == index)
+		return;
+
+	nco_port = pgm_read_byte(&active_port[next]);
+	//ahead for next tick, the table holds the level of the antenna after the index
+	DACB.CH0DATA = pgm_read_word(&active_dac[(next - 1) & step_mask]);
+	if (next != 0)
+	{
+		DACB.CH1DATA = 0;
+	}
+	else
+	{
+		frame++;
+		DACB.CH1DATA = FRAME_CODE(frame);
+	}
+}
+
+ISR(TCC0_OVF_vect)
+{
+	LOAD_ENTER();
+
+	if (commutation_mode == COMMUTATION_MODE_NCO)
+	{
+		NcoTick();
+		LOAD_LEAVE(LOAD_COMMUTATION);
+		return;
+	}
+
+	/* step is 0 at every overflow in the DMA driven modes */
+	if (switch_clksel != TC_CLKSEL_OFF_gc || (lock_start && step == 0))
+		RotationStart();
+
+	if (commutation_mode == COMMUTATION_MODE_ISR)
+	{
+		uint8_t current = step;
+
+		PORTD.OUT = pgm_read_byte(&active_port[current]);
+		//ahead for next event
+		DACB.CH0DATA = pgm_read_word(&active_dac[current]);
+
+		if (current == step_mask)
+		{
+			step = 0;
+			RotationLastStep();
+			DACB.CH1DATA = FRAME_CODE(frame);
+		}
+		else
+		{
+			step = current + 1;
+			DACB.CH1DATA = 0;
+		}
+	}
+	LOAD_LEAVE(LOAD_COMMUTATION);
+}
+
+ISR(DMA_CH0_vect)
+{
+	LOAD_ENTER();
+
+	DMA.CH0.CTRLB |= DMA_CH_TRNIF_bm;
+	RotationLastStep();
+	LOAD_LEAVE(LOAD_COMMUTATION);
+}
@@ -0,0 +1,147 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+#ifndef COMMUTATION_H
+#define COMMUTATION_H
+
+#include "avr_compiler.h"
+
+/*! \brief Shortest step the planner will hand out, in CPU cycles.
+ *
+ *  Leaves room for the step ISR in COMMUTATION_MODE_ISR.
+ */
+#define COMMUTATION_MIN_STEP_CYCLES 320
+
+/*! \brief Tick rate of the phase accumulator in COMMUTATION_MODE_NCO, in Hz.
+ *
+ *  One tick is F_CPU / NCO_TICK_HZ = 320 cycles at 32 MHz, spent at medium
+ *  level above the UART. The tick only adds the increment and compares the
+ *  antenna of the next tick, the tables are read on the tick before a step
+ *  edge (at most every other tick).
+ */
+#define NCO_TICK_HZ 100000UL
+
+#if (F_CPU % NCO_TICK_HZ)
+#error F_CPU is not a multiple of NCO_TICK_HZ
+#endif
+
+/*! \brief Most antennas COMMUTATION_MODE_AWEX can drive, one per TCC0 compare channel. */
+#define AWEX_ANTENNA_MAX 4
+
+/*! \brief Break-before-make gap of COMMUTATION_MODE_AWEX, in ns.
+ *
+ *  Time between one select line going low and the next going high, long
+ *  enough for the PIN diode that was on to stop conducting.
+ */
+#ifndef AWEX_DEAD_TIME_NS
+#define AWEX_DEAD_TIME_NS 500UL
+#endif
+
+/*! \brief DAC samples per step in COMMUTATION_MODE_CROSSFADE. */
+#define CROSSFADE_SAMPLES 16
+/*! \brief Samples of raised cosine at the start of every crossfade step. */
+#define CROSSFADE_FADE_SAMPLES 8
+
+/*! \brief Build in COMMUTATION_MODE_CROSSFADE. Its DMA banks hold two
+ *         rotations of DAC samples, about 2.5 kB of SRAM; off by default.
+ */
+#ifndef COMMUTATION_CROSSFADE
+#define COMMUTATION_CROSSFADE 0
+#endif
+
+/*! \brief Frame codes on DAC CH1, the rotation counter runs modulo this. */
+#define FRAME_CODE_COUNT 16
+/*! \brief DAC CH1 level of frame code \em c, 0 is left for "no rotation start". */
+#define FRAME_CODE_LEVEL(c) (((c) + 1) * (4096 / (FRAME_CODE_COUNT + 1)))
+
+#if (FRAME_CODE_COUNT & (FRAME_CODE_COUNT - 1))
+#error FRAME_CODE_COUNT is not a power of two
+#endif
+
+#if (AWEX_DEAD_TIME_NS * (F_CPU / 1000000UL) / 1000UL > 0xFF)
+#error AWEX_DEAD_TIME_NS does not fit the AWEX dead time register
+#endif
+
+/*! \brief DMA channels the commutation takes in \em mode (bit n: CHn).
+ *
+ *  CH0 always, its vector is part of commutation.c; CH1 only in the DMA,
+ *  AWEX and crossfade modes.
+ */
+#define COMMUTATION_DMA_CHANNELS(mode) \
+	(((mode) == COMMUTATION_MODE_ISR || (mode) == COMMUTATION_MODE_NCO) ? 0x01 : 0x03)
+
+/*! \brief How the antenna steps are driven.
+ *
+ *  All modes use TCC0 as step timer and event channel 0 (TCC0 overflow) to
+ *  trigger the DAC conversion of the sync marker. The marker is the antenna
+ *  staircase on DACB CH0 (PB2) plus a frame code on CH1 (PB3): during the
+ *  first step of every rotation CH1 holds FRAME_CODE_LEVEL(rotation number
+ *  modulo FRAME_CODE_COUNT), during the other steps 0. A missing or repeated
+ *  code tells the flowgraph a rotation was dropped or duplicated.
+ *
+ *  COMMUTATION_MODE_ISR: ISR(TCC0_OVF_vect) writes PORTD and the next DAC value.
+ *  COMMUTATION_MODE_DMA: DMA CH0 copies the port pattern to PORTD.OUT on every
+ *                        event channel 0 strobe and DMA CH1 refills DACB CH0
+ *                        whenever its data register is empty, no CPU involved.
+ *  COMMUTATION_MODE_NCO: TCC0 ticks at NCO_TICK_HZ and a 32 bit phase
+ *                        accumulator picks the antenna with its top bits. Any
+ *                        rotation frequency is exact to the mHz, the edges
+ *                        land on the nearest tick.
+ *  COMMUTATION_MODE_AWEX: one select line per antenna on PC0, PC2, PC4 and
+ *                        PC6, driven by TCC0 compare channels A-D through
+ *                        AWEXC dead-time insertion. DMA CH0 writes the
+ *                        compare buffers on every step, a line only goes
+ *                        high AWEX_DEAD_TIME_NS after the previous one went
+ *                        low. At most AWEX_ANTENNA_MAX antennas, no debug
+ *                        pulse (PC0 is antenna 0).
+ *  COMMUTATION_MODE_CROSSFADE: analogue PIN diode bias from DACB CH0 (PB2, even
+ *                        antennas) and CH1 (PB3, odd antennas). TCC0 runs at
+ *                        CROSSFADE_SAMPLES per step, DMA CH1 streams both
+ *                        DAC channels and DMA CH0 the bias routing on PORTD:
+ *                        PD0-PD2 even antenna / 2, PD4-PD6 odd antenna / 2.
+ *                        Every step starts with a raised cosine crossfade
+ *                        from the previous antenna. No sync marker.
+ */
+typedef enum commutation_mode {
+	COMMUTATION_MODE_ISR,
+	COMMUTATION_MODE_DMA,
+	COMMUTATION_MODE_NCO,
+	COMMUTATION_MODE_AWEX,
+	COMMUTATION_MODE_CROSSFADE,
+} commutation_mode_t;
+
+/*! \brief TCC0 settings for one rotation frequency, see commutation_plan(). */
+typedef struct commutation_plan {
+	/* \brief Phase increment per tick (NCO mode). */
+	uint32_t nco_inc;
+	/* \brief Remainder of the increment in 1/(NCO_TICK_HZ * 1000) (NCO mode). */
+	uint32_t nco_rem;
+	/* \brief TCC0 clock select, TC_CLKSEL_DIVn_gc. */
+	uint8_t clksel;
+	/* \brief TCC0 period, the step lasts PER + 1 timer ticks. */
+	uint16_t per;
+	/* \brief Width of the debug pulse on PC0 in timer ticks. */
+	uint16_t pulse;
+	/* \brief Number of antennas, one step per antenna. */
+	uint8_t antennas;
+	/* \brief Rotation frequency these settings give, in mHz. */
+	uint32_t achieved_mhz;
+	/* \brief Error of achieved against requested frequency, in ppm. */
+	int32_t error_ppm;
+} commutation_plan_t;
+
+bool commutation_plan(commutation_mode_t mode, uint32_t f_cpu,
+                      uint32_t rotation_mhz, uint8_t antennas, commutation_plan_t *plan);
+void commutation_init(commutation_mode_t mode, const commutation_plan_t *plan);
+void commutation_apply(const commutation_plan_t *plan);
+void commutation_trim(int32_t cycles);
+bool commutation_lock_timer(TC0_t *tc, uint8_t per_rotation);
+uint8_t commutation_rotation(void);
+void commutation_frame_codes(bool on);
+
+#endif
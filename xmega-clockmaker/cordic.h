@@ -0,0 +1,19 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+#ifndef CORDIC_H
+#define CORDIC_H
+
+#include <stdint.h>
+
+/*! \brief CORDIC iterations, the last table angle is one binary angle unit. */
+#define CORDIC_ITERATIONS 14
+
+uint16_t cordic_atan2(int32_t y, int32_t x, uint32_t *magnitude);
+
+#endif
@@ -0,0 +1,14 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+#ifndef HOST_AVR_CPUFUNC_H
+#define HOST_AVR_CPUFUNC_H
+
+#define _NOP() ((void)0)
+
+#endif
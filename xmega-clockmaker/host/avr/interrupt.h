@@ -0,0 +1,18 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+/* Interrupts for the host build: an ISR is a function the bench calls. */
+
+#ifndef HOST_AVR_INTERRUPT_H
+#define HOST_AVR_INTERRUPT_H
+
+#define ISR(vector) void vector(void); void vector(void)
+#define sei() ((void)0)
+#define cli() ((void)0)
+
+#endif
@@ -0,0 +1,248 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+/* Register model of the ATxmega256A3U for the host build (make host).
+ *
+ * Every peripheral is a plain struct in memory (host/regs.c) with the names
+ * of the real <avr/io.h>, only what the firmware uses. Nothing happens on a
+ * write: the bench code plays the hardware, it reads what the firmware wrote,
+ * sets flags and calls the ISRs, which are ordinary functions here.
+ */
+
+#ifndef HOST_AVR_IO_H
+#define HOST_AVR_IO_H
+
+#include <stdint.h>
+#define register8_t volatile uint8_t
+#define register16_t volatile uint16_t
+#define _WORDREGISTER(r) volatile uint16_t r
+typedef struct { register8_t DIR, DIRSET, DIRCLR, DIRTGL, OUT, OUTSET, OUTCLR, OUTTGL, IN, INTCTRL, INT0MASK, INT1MASK, INTFLAGS, r0, REMAP, r1, PIN0CTRL, PIN1CTRL, PIN2CTRL, PIN3CTRL, PIN4CTRL, PIN5CTRL, PIN6CTRL, PIN7CTRL; } PORT_t;
+typedef struct { register8_t CTRLA, CTRLB, CTRLC, CTRLD, CTRLE, r0, INTCTRLA, INTCTRLB, CTRLFCLR, CTRLFSET, CTRLGCLR, CTRLGSET, INTFLAGS; register8_t r1[2]; register8_t TEMP; register8_t r2[16]; register16_t CNT; register8_t r3[4]; register16_t PER, CCA, CCB, CCC, CCD; register8_t r4[6]; register16_t PERBUF, CCABUF, CCBBUF, CCCBUF, CCDBUF; } TC0_t;
+typedef struct { register8_t CTRLA, CTRLB, CTRLC, CTRLD, CTRLE, r0, INTCTRLA, INTCTRLB, CTRLFCLR, CTRLFSET, CTRLGCLR, CTRLGSET, INTFLAGS; register8_t r1[2]; register8_t TEMP; register8_t r2[16]; register16_t CNT; register8_t r3[4]; register16_t PER, CCA, CCB; register8_t r4[10]; register16_t PERBUF, CCABUF, CCBBUF; } TC1_t;
+typedef struct { register8_t CTRL, r0, FDEMASK, FDCTRL, STATUS, r1, DTBOTH, DTBOTHBUF, DTLS, DTHS, DTLSBUF, DTHSBUF, OUTOVEN; } AWEX_t;
+typedef struct { register8_t CTRLA, CTRLB, CTRLC, EVCTRL, TIMCTRL, STATUS; register8_t r0[2]; register8_t CH0GAINCAL, CH0OFFSETCAL, CH1GAINCAL, CH1OFFSETCAL; register8_t r1[12]; register16_t CH0DATA, CH1DATA; } DAC_t;
+typedef struct { register8_t CTRLA, CTRLB, ADDRCTRL, TRIGSRC; register16_t TRFCNT; register8_t REPCNT, r0, SRCADDR0, SRCADDR1, SRCADDR2, r1, DESTADDR0, DESTADDR1, DESTADDR2, r2; } DMA_CH_t;
+typedef struct { register8_t CTRL, r0[2], INTFLAGS, STATUS, r1; register16_t TEMP; register8_t r2[8]; DMA_CH_t CH0, CH1, CH2, CH3; } DMA_t;
+typedef struct { register8_t CH0MUX, CH1MUX, CH2MUX, CH3MUX, CH4MUX, CH5MUX, CH6MUX, CH7MUX, CH0CTRL, CH1CTRL, CH2CTRL, CH3CTRL, CH4CTRL, CH5CTRL, CH6CTRL, CH7CTRL, STROBE, DATA; } EVSYS_t;
+typedef struct { register8_t CTRL, MUXCTRL, INTCTRL, INTFLAGS; register16_t RES; register8_t SCAN, r0; } ADC_CH_t;
+typedef struct { register8_t CTRLA, CTRLB, REFCTRL, EVCTRL, PRESCALER, r0, INTFLAGS, TEMP; register8_t r1[4]; register16_t CAL; register8_t r2[2]; register16_t CH0RES, CH1RES, CH2RES, CH3RES, CMP; register8_t r3[6]; ADC_CH_t CH0, CH1, CH2, CH3; } ADC_t;
+typedef struct { register8_t DATA, r0, STATUS, r1, CTRLA, CTRLB, CTRLC, BAUDCTRLA, BAUDCTRLB; } USART_t;
+typedef struct { register8_t CTRL, STATUS, XOSCCTRL, XOSCFAIL, RC32KCAL, PLLCTRL, DFLLCTRL; } OSC_t;
+typedef struct { register8_t CTRL, PSCTRL, LOCK, RTCCTRL, USBCTRL; } CLK_t;
+typedef struct { register8_t CTRL, r0, CALA, CALB, COMP0, COMP1, COMP2, r1; } DFLL_t;
+typedef struct { register8_t STATUS, INTPRI, CTRL; } PMIC_t;
+
+extern PORT_t PORTA, PORTB, PORTC, PORTD, PORTE, PORTF;
+extern TC0_t TCC0, TCD0, TCE0, TCF0;
+extern TC1_t TCC1, TCD1, TCE1;
+extern AWEX_t AWEXC;
+extern DAC_t DACB;
+extern DMA_t DMA;
+extern EVSYS_t EVSYS;
+extern ADC_t ADCA;
+extern USART_t USARTC0, USARTC1, USARTD0, USARTD1, USARTE0, USARTF0;
+extern OSC_t OSC;
+extern CLK_t CLK;
+extern DFLL_t DFLLRC32M, DFLLRC2M;
+extern PMIC_t PMIC;
+extern volatile uint8_t SREG, CCP;
+/* uart.c tests for the USARTs of the device with #ifdef */
+#define USARTC0 USARTC0
+#define USARTC1 USARTC1
+#define USARTD0 USARTD0
+#define USARTD1 USARTD1
+#define USARTE0 USARTE0
+#define USARTF0 USARTF0
+
+#define PIN0_bm 0x01
+#define PIN1_bm 0x02
+#define PIN2_bm 0x04
+#define PIN3_bm 0x08
+#define PIN4_bm 0x10
+#define PIN5_bm 0x20
+#define PIN6_bm 0x40
+#define PIN7_bm 0x80
+#define PIN0_bp 0
+#define PORT_ISC_gm 0x07
+#define PORT_ISC_BOTHEDGES_gc 0x00
+#define PORT_ISC_RISING_gc 0x01
+#define PORT_ISC_FALLING_gc 0x02
+#define PORT_ISC_INPUT_DISABLE_gc 0x07
+#define PORT_INVEN_bm 0x40
+
+typedef enum { TC_CLKSEL_OFF_gc, TC_CLKSEL_DIV1_gc, TC_CLKSEL_DIV2_gc, TC_CLKSEL_DIV4_gc, TC_CLKSEL_DIV8_gc, TC_CLKSEL_DIV64_gc, TC_CLKSEL_DIV256_gc, TC_CLKSEL_DIV1024_gc, TC_CLKSEL_EVCH0_gc, TC_CLKSEL_EVCH1_gc, TC_CLKSEL_EVCH2_gc, TC_CLKSEL_EVCH3_gc, TC_CLKSEL_EVCH4_gc, TC_CLKSEL_EVCH5_gc, TC_CLKSEL_EVCH6_gc, TC_CLKSEL_EVCH7_gc } TC_CLKSEL_t;
+#define TC0_CCDEN_bm 0x80
+#define TC0_CCCEN_bm 0x40
+#define TC0_CCBEN_bm 0x20
+#define TC0_CCAEN_bm 0x10
+#define TC1_CCBEN_bm 0x20
+#define TC1_CCAEN_bm 0x10
+typedef enum { TC_WGMODE_NORMAL_gc = 0, TC_WGMODE_FRQ_gc = 1, TC_WGMODE_SS_gc = 3, TC_WGMODE_DS_T_gc = 5, TC_WGMODE_DS_TB_gc = 6, TC_WGMODE_DS_B_gc = 7 } TC_WGMODE_t;
+typedef enum { TC_EVACT_OFF_gc = 0, TC_EVACT_CAPT_gc = 0x20, TC_EVACT_UPDOWN_gc = 0x40, TC_EVACT_QDEC_gc = 0x60, TC_EVACT_RESTART_gc = 0x80, TC_EVACT_FRQ_gc = 0xA0, TC_EVACT_PW_gc = 0xC0 } TC_EVACT_t;
+typedef enum { TC_EVSEL_OFF_gc = 0, TC_EVSEL_CH0_gc = 8, TC_EVSEL_CH1_gc, TC_EVSEL_CH2_gc, TC_EVSEL_CH3_gc, TC_EVSEL_CH4_gc, TC_EVSEL_CH5_gc, TC_EVSEL_CH6_gc, TC_EVSEL_CH7_gc } TC_EVSEL_t;
+#define TC0_EVDLY_bm 0x10
+#define TC1_EVDLY_bm 0x10
+typedef enum { TC_OVFINTLVL_OFF_gc, TC_OVFINTLVL_LO_gc, TC_OVFINTLVL_MED_gc, TC_OVFINTLVL_HI_gc } TC_OVFINTLVL_t;
+#define TC_OVFINTLVL_gm 0x03
+typedef enum { TC_CCAINTLVL_OFF_gc, TC_CCAINTLVL_LO_gc, TC_CCAINTLVL_MED_gc, TC_CCAINTLVL_HI_gc } TC_CCAINTLVL_t;
+typedef enum { TC_CCBINTLVL_OFF_gc = 0, TC_CCBINTLVL_LO_gc = 4, TC_CCBINTLVL_MED_gc = 8, TC_CCBINTLVL_HI_gc = 12 } TC_CCBINTLVL_t;
+#define TC0_CCAINTLVL_gm 0x03
+#define TC0_CCBINTLVL_gm 0x0C
+#define TC1_CCAINTLVL_gm 0x03
+#define TC1_CCBINTLVL_gm 0x0C
+#define TC_CMD_RESTART_gc 0x08
+#define TC_CMD_UPDATE_gc 0x04
+#define TC0_OVFIF_bm 0x01
+#define TC0_CCAIF_bm 0x10
+#define TC0_CCBIF_bm 0x20
+#define TC1_OVFIF_bm 0x01
+#define TC1_CCAIF_bm 0x10
+#define TC1_CCBIF_bm 0x20
+#define TC0_PERBV_bm 0x01
+
+#define AWEX_PGM_bm 0x20
+#define AWEX_CWCM_bm 0x10
+#define AWEX_DTICCDEN_bm 0x08
+#define AWEX_DTICCCEN_bm 0x04
+#define AWEX_DTICCBEN_bm 0x02
+#define AWEX_DTICCAEN_bm 0x01
+
+#define DAC_IDOEN_bm 0x10
+#define DAC_CH1EN_bm 0x08
+#define DAC_CH0EN_bm 0x04
+#define DAC_LPMODE_bm 0x02
+#define DAC_ENABLE_bm 0x01
+typedef enum { DAC_CHSEL_SINGLE_gc = 0, DAC_CHSEL_SINGLE1_gc = 0x20, DAC_CHSEL_DUAL_gc = 0x40 } DAC_CHSEL_t;
+#define DAC_CH1TRIG_bm 0x02
+#define DAC_CH0TRIG_bm 0x01
+typedef enum { DAC_REFSEL_INT1V_gc = 0, DAC_REFSEL_AVCC_gc = 0x08, DAC_REFSEL_AREFA_gc = 0x10, DAC_REFSEL_AREFB_gc = 0x18 } DAC_REFSEL_t;
+typedef enum { DAC_EVSEL_0_gc, DAC_EVSEL_1_gc, DAC_EVSEL_2_gc, DAC_EVSEL_3_gc, DAC_EVSEL_4_gc, DAC_EVSEL_5_gc, DAC_EVSEL_6_gc, DAC_EVSEL_7_gc } DAC_EVSEL_t;
+#define DAC_CH0DRE_bm 0x01
+#define DAC_CH1DRE_bm 0x02
+typedef enum { DAC_CONINTVAL_1CLK_gc = 0, DAC_CONINTVAL_2CLK_gc = 0x10, DAC_CONINTVAL_4CLK_gc = 0x20, DAC_CONINTVAL_8CLK_gc = 0x30, DAC_CONINTVAL_16CLK_gc = 0x40, DAC_CONINTVAL_32CLK_gc = 0x50 } DAC_CONINTVAL_t;
+typedef enum { DAC_REFRESH_16CLK_gc = 0, DAC_REFRESH_32CLK_gc, DAC_REFRESH_64CLK_gc, DAC_REFRESH_128CLK_gc, DAC_REFRESH_256CLK_gc } DAC_REFRESH_t;
+
+#define DMA_ENABLE_bm 0x80
+#define DMA_RESET_bm 0x40
+typedef enum { DMA_DBUFMODE_DISABLED_gc = 0, DMA_DBUFMODE_CH01_gc = 4, DMA_DBUFMODE_CH23_gc = 8, DMA_DBUFMODE_CH01CH23_gc = 12 } DMA_DBUFMODE_t;
+typedef enum { DMA_PRIMODE_RR0123_gc = 0, DMA_PRIMODE_CH0RR123_gc, DMA_PRIMODE_CH01RR23_gc, DMA_PRIMODE_CH0123_gc } DMA_PRIMODE_t;
+#define DMA_CH_ENABLE_bm 0x80
+#define DMA_CH_RESET_bm 0x40
+#define DMA_CH_REPEAT_bm 0x20
+#define DMA_CH_TRFREQ_bm 0x10
+#define DMA_CH_SINGLE_bm 0x04
+typedef enum { DMA_CH_BURSTLEN_1BYTE_gc, DMA_CH_BURSTLEN_2BYTE_gc, DMA_CH_BURSTLEN_4BYTE_gc, DMA_CH_BURSTLEN_8BYTE_gc } DMA_CH_BURSTLEN_t;
+#define DMA_CH_CHBUSY_bm 0x80
+#define DMA_CH_CHPEND_bm 0x40
+#define DMA_CH_ERRIF_bm 0x20
+#define DMA_CH_TRNIF_bm 0x10
+typedef enum { DMA_CH_TRNINTLVL_OFF_gc, DMA_CH_TRNINTLVL_LO_gc, DMA_CH_TRNINTLVL_MED_gc, DMA_CH_TRNINTLVL_HI_gc } DMA_CH_TRNINTLVL_t;
+typedef enum { DMA_CH_SRCRELOAD_NONE_gc = 0, DMA_CH_SRCRELOAD_BLOCK_gc = 0x40, DMA_CH_SRCRELOAD_BURST_gc = 0x80, DMA_CH_SRCRELOAD_TRANSACTION_gc = 0xC0 } DMA_CH_SRCRELOAD_t;
+typedef enum { DMA_CH_SRCDIR_FIXED_gc = 0, DMA_CH_SRCDIR_INC_gc = 0x10, DMA_CH_SRCDIR_DEC_gc = 0x20 } DMA_CH_SRCDIR_t;
+typedef enum { DMA_CH_DESTRELOAD_NONE_gc = 0, DMA_CH_DESTRELOAD_BLOCK_gc = 4, DMA_CH_DESTRELOAD_BURST_gc = 8, DMA_CH_DESTRELOAD_TRANSACTION_gc = 12 } DMA_CH_DESTRELOAD_t;
+typedef enum { DMA_CH_DESTDIR_FIXED_gc = 0, DMA_CH_DESTDIR_INC_gc = 1, DMA_CH_DESTDIR_DEC_gc = 2 } DMA_CH_DESTDIR_t;
+typedef enum { DMA_CH_TRIGSRC_OFF_gc = 0, DMA_CH_TRIGSRC_EVSYS_CH0_gc = 1, DMA_CH_TRIGSRC_EVSYS_CH1_gc = 2, DMA_CH_TRIGSRC_EVSYS_CH2_gc = 3,
+	DMA_CH_TRIGSRC_ADCA_CH0_gc = 0x10, DMA_CH_TRIGSRC_ADCA_CH4_gc = 0x14, DMA_CH_TRIGSRC_DACB_CH0_gc = 0x25, DMA_CH_TRIGSRC_DACB_CH1_gc = 0x26,
+	DMA_CH_TRIGSRC_TCC0_OVF_gc = 0x40, DMA_CH_TRIGSRC_TCC0_CCA_gc = 0x42, DMA_CH_TRIGSRC_TCC1_OVF_gc = 0x46, DMA_CH_TRIGSRC_USARTC0_DRE_gc = 0x4C, DMA_CH_TRIGSRC_USARTC1_DRE_gc = 0x4E,
+	DMA_CH_TRIGSRC_TCD0_OVF_gc = 0x60, DMA_CH_TRIGSRC_TCD1_OVF_gc = 0x66, DMA_CH_TRIGSRC_USARTD0_DRE_gc = 0x6C, DMA_CH_TRIGSRC_USARTD1_DRE_gc = 0x6E,
+	DMA_CH_TRIGSRC_TCE0_OVF_gc = 0x80, DMA_CH_TRIGSRC_TCE1_OVF_gc = 0x86, DMA_CH_TRIGSRC_USARTE0_DRE_gc = 0x8C,
+	DMA_CH_TRIGSRC_TCF0_OVF_gc = 0xA0, DMA_CH_TRIGSRC_USARTF0_DRE_gc = 0xAC } DMA_CH_TRIGSRC_t;
+#define DMA_CH0TRNIF_bm 0x01
+#define DMA_CH1TRNIF_bm 0x02
+#define DMA_CH2TRNIF_bm 0x04
+#define DMA_CH3TRNIF_bm 0x08
+#define DMA_CH0ERRIF_bm 0x10
+#define DMA_CH1ERRIF_bm 0x20
+#define DMA_CH2ERRIF_bm 0x40
+#define DMA_CH3ERRIF_bm 0x80
+
+typedef enum { EVSYS_CHMUX_OFF_gc = 0, EVSYS_CHMUX_ADCA_CH0_gc = 0x20, EVSYS_CHMUX_PORTA_PIN0_gc = 0x50, EVSYS_CHMUX_PORTA_PIN1_gc, EVSYS_CHMUX_PORTA_PIN2_gc,
+	EVSYS_CHMUX_PORTC_PIN0_gc = 0x60, EVSYS_CHMUX_PORTC_PIN1_gc, EVSYS_CHMUX_PORTC_PIN2_gc,
+	EVSYS_CHMUX_PORTD_PIN0_gc = 0x68, EVSYS_CHMUX_PORTD_PIN1_gc, EVSYS_CHMUX_PORTD_PIN2_gc, EVSYS_CHMUX_PORTD_PIN3_gc, EVSYS_CHMUX_PORTD_PIN4_gc, EVSYS_CHMUX_PORTD_PIN5_gc, EVSYS_CHMUX_PORTD_PIN6_gc, EVSYS_CHMUX_PORTD_PIN7_gc,
+	EVSYS_CHMUX_PORTE_PIN0_gc = 0x70, EVSYS_CHMUX_PORTE_PIN1_gc, EVSYS_CHMUX_PORTE_PIN2_gc,
+	EVSYS_CHMUX_TCC0_OVF_gc = 0xC0, EVSYS_CHMUX_TCC0_CCA_gc = 0xC4, EVSYS_CHMUX_TCC1_OVF_gc = 0xC8, EVSYS_CHMUX_TCD0_OVF_gc = 0xD0, EVSYS_CHMUX_TCD1_OVF_gc = 0xD8, EVSYS_CHMUX_TCE0_OVF_gc = 0xE0, EVSYS_CHMUX_TCE1_OVF_gc = 0xE8, EVSYS_CHMUX_TCF0_OVF_gc = 0xF0 } EVSYS_CHMUX_t;
+typedef enum { EVSYS_DIGFILT_1SAMPLE_gc = 0, EVSYS_DIGFILT_2SAMPLES_gc, EVSYS_DIGFILT_3SAMPLES_gc, EVSYS_DIGFILT_4SAMPLES_gc, EVSYS_DIGFILT_5SAMPLES_gc, EVSYS_DIGFILT_6SAMPLES_gc, EVSYS_DIGFILT_7SAMPLES_gc, EVSYS_DIGFILT_8SAMPLES_gc } EVSYS_DIGFILT_t;
+
+typedef enum { ADC_DMASEL_OFF_gc = 0, ADC_DMASEL_CH01_gc = 0x40, ADC_DMASEL_CH012_gc = 0x80, ADC_DMASEL_CH0123_gc = 0xC0 } ADC_DMASEL_t;
+#define ADC_CH0START_bm 0x04
+#define ADC_FLUSH_bm 0x02
+#define ADC_ENABLE_bm 0x01
+#define ADC_CONMODE_bm 0x10
+#define ADC_FREERUN_bm 0x08
+typedef enum { ADC_RESOLUTION_12BIT_gc = 0, ADC_RESOLUTION_8BIT_gc = 4, ADC_RESOLUTION_LEFT12BIT_gc = 6 } ADC_RESOLUTION_t;
+typedef enum { ADC_REFSEL_INT1V_gc = 0, ADC_REFSEL_INTVCC_gc = 0x10, ADC_REFSEL_AREFA_gc = 0x20, ADC_REFSEL_AREFB_gc = 0x30, ADC_REFSEL_INTVCC2_gc = 0x40 } ADC_REFSEL_t;
+typedef enum { ADC_EVSEL_0123_gc = 0, ADC_EVSEL_1234_gc = 8, ADC_EVSEL_2345_gc = 0x10, ADC_EVSEL_3456_gc = 0x18, ADC_EVSEL_4567_gc = 0x20, ADC_EVSEL_567_gc = 0x28, ADC_EVSEL_67_gc = 0x30, ADC_EVSEL_7_gc = 0x38 } ADC_EVSEL_t;
+typedef enum { ADC_EVACT_NONE_gc = 0, ADC_EVACT_CH0_gc, ADC_EVACT_CH01_gc, ADC_EVACT_CH012_gc, ADC_EVACT_CH0123_gc, ADC_EVACT_SWEEP_gc, ADC_EVACT_SYNCSWEEP_gc } ADC_EVACT_t;
+typedef enum { ADC_PRESCALER_DIV4_gc = 0, ADC_PRESCALER_DIV8_gc, ADC_PRESCALER_DIV16_gc, ADC_PRESCALER_DIV32_gc, ADC_PRESCALER_DIV64_gc, ADC_PRESCALER_DIV128_gc, ADC_PRESCALER_DIV256_gc, ADC_PRESCALER_DIV512_gc } ADC_PRESCALER_t;
+#define ADC_CH_START_bm 0x80
+typedef enum { ADC_CH_GAIN_1X_gc = 0 } ADC_CH_GAIN_t;
+typedef enum { ADC_CH_INPUTMODE_INTERNAL_gc = 0, ADC_CH_INPUTMODE_SINGLEENDED_gc = 1, ADC_CH_INPUTMODE_DIFF_gc = 2 } ADC_CH_INPUTMODE_t;
+typedef enum { ADC_CH_MUXPOS_PIN0_gc = 0, ADC_CH_MUXPOS_PIN1_gc = 8, ADC_CH_MUXPOS_PIN2_gc = 0x10, ADC_CH_MUXPOS_PIN3_gc = 0x18, ADC_CH_MUXPOS_PIN4_gc = 0x20 } ADC_CH_MUXPOS_t;
+#define ADC_CH0IF_bm 0x01
+
+typedef enum { USART_RXCINTLVL_OFF_gc = 0, USART_RXCINTLVL_LO_gc = 0x10, USART_RXCINTLVL_MED_gc = 0x20, USART_RXCINTLVL_HI_gc = 0x30 } USART_RXCINTLVL_t;
+typedef enum { USART_TXCINTLVL_OFF_gc = 0, USART_TXCINTLVL_LO_gc = 0x04, USART_TXCINTLVL_MED_gc = 0x08, USART_TXCINTLVL_HI_gc = 0x0C } USART_TXCINTLVL_t;
+typedef enum { USART_DREINTLVL_OFF_gc = 0, USART_DREINTLVL_LO_gc = 1, USART_DREINTLVL_MED_gc = 2, USART_DREINTLVL_HI_gc = 3 } USART_DREINTLVL_t;
+#define USART_RXCINTLVL_gm 0x30
+#define USART_TXCINTLVL_gm 0x0C
+#define USART_DREINTLVL_gm 0x03
+#define USART_RXCIF_bm 0x80
+#define USART_TXCIF_bm 0x40
+#define USART_DREIF_bm 0x20
+#define USART_RXEN_bm 0x10
+#define USART_TXEN_bm 0x08
+#define USART_CLK2X_bm 0x04
+#define USART_TXB8_bm 0x01
+#define USART_RXB8_bm 0x01
+typedef enum { USART_CMODE_ASYNCHRONOUS_gc = 0, USART_CMODE_SYNCHRONOUS_gc = 0x40 } USART_CMODE_t;
+#define USART_CMODE_gm 0xC0
+typedef enum { USART_PMODE_DISABLED_gc = 0, USART_PMODE_EVEN_gc = 0x20, USART_PMODE_ODD_gc = 0x30 } USART_PMODE_t;
+#define USART_SBMODE_bm 0x08
+typedef enum { USART_CHSIZE_5BIT_gc = 0, USART_CHSIZE_6BIT_gc, USART_CHSIZE_7BIT_gc, USART_CHSIZE_8BIT_gc, USART_CHSIZE_9BIT_gc = 7 } USART_CHSIZE_t;
+#define USART_BSCALE0_bp 4
+#define USART_BSCALE_gm 0xF0
+
+#define OSC_PLLEN_bm 0x10
+#define OSC_XOSCEN_bm 0x08
+#define OSC_RC32KEN_bm 0x04
+#define OSC_RC32MEN_bm 0x02
+#define OSC_RC2MEN_bm 0x01
+#define OSC_PLLRDY_bm 0x10
+#define OSC_XOSCRDY_bm 0x08
+#define OSC_RC32KRDY_bm 0x04
+#define OSC_RC32MRDY_bm 0x02
+#define OSC_RC2MRDY_bm 0x01
+typedef enum { OSC_FRQRANGE_04TO2_gc = 0, OSC_FRQRANGE_2TO9_gc = 0x40, OSC_FRQRANGE_9TO12_gc = 0x80, OSC_FRQRANGE_12TO16_gc = 0xC0 } OSC_FRQRANGE_t;
+#define OSC_X32KLPM_bm 0x20
+typedef enum { OSC_XOSCSEL_EXTCLK_gc = 0, OSC_XOSCSEL_32KHz_gc = 2, OSC_XOSCSEL_XTAL_256CLK_gc = 3, OSC_XOSCSEL_XTAL_1KCLK_gc = 7, OSC_XOSCSEL_XTAL_16KCLK_gc = 0x0B } OSC_XOSCSEL_t;
+#define OSC_XOSCFDIF_bm 0x02
+#define OSC_XOSCFDEN_bm 0x01
+typedef enum { OSC_PLLSRC_RC2M_gc = 0, OSC_PLLSRC_RC32M_gc = 0x80, OSC_PLLSRC_XOSC_gc = 0xC0 } OSC_PLLSRC_t;
+#define OSC_PLLFAC_gm 0x1F
+#define OSC_PLLFAC_gp 0
+#define OSC_RC32MCREF_gm 0x06
+#define OSC_RC32MCREF0_bm 0x02
+#define OSC_RC2MCREF_bm 0x01
+typedef enum { OSC_RC32MCREF_RC32K_gc = 0, OSC_RC32MCREF_XOSC32K_gc = 2, OSC_RC32MCREF_USBSOF_gc = 4 } OSC_RC32MCREF_t;
+typedef enum { CLK_SCLKSEL_RC2M_gc = 0, CLK_SCLKSEL_RC32M_gc, CLK_SCLKSEL_RC32K_gc, CLK_SCLKSEL_XOSC_gc, CLK_SCLKSEL_PLL_gc } CLK_SCLKSEL_t;
+#define CLK_SCLKSEL_gm 0x07
+typedef enum { CLK_PSADIV_1_gc = 0 } CLK_PSADIV_t;
+typedef enum { CLK_PSBCDIV_1_1_gc = 0 } CLK_PSBCDIV_t;
+#define CLK_PSADIV_gm 0x7C
+#define CLK_PSBCDIV_gm 0x03
+typedef enum { CLK_RTCSRC_ULP_gc = 0, CLK_RTCSRC_RCOSC_gc = 4 } CLK_RTCSRC_t;
+#define CLK_RTCSRC_gm 0x0E
+#define CLK_RTCEN_bm 0x01
+#define CLK_LOCK_bm 0x01
+#define DFLL_ENABLE_bm 0x01
+#define PMIC_HILVLEN_bm 0x04
+#define PMIC_MEDLVLEN_bm 0x02
+#define PMIC_LOLVLEN_bm 0x01
+#define PMIC_NMIEX_bm 0x80
+#define CCP_IOREG_gc 0xD8
+#endif
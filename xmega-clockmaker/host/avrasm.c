@@ -0,0 +1,797 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+/* AVR assembly on the host: assembles a .S file of the firmware the way
+ * avr-gcc does and runs its functions on a model of the registers, SREG and
+ * data space, counting XMEGA cycles.
+ *
+ * The assembler knows labels, numeric local labels (1: with 1f and 1b),
+ * .macro with \arguments, .rept, .if/.else/.endif, lo8() and hi8() and
+ * integer expressions with + - < and parentheses; other directives are
+ * skipped, comments are ; and //. The model has only the instructions the
+ * hand coded functions use, anything else fails the load. SREG keeps C, Z,
+ * N, V and S, not H. Cycles are those of the AVRxm core with the 22 bit
+ * program counter of the ATxmega256A3U: CALL 4, RET 5, ST Z+ 1.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "avrasm.h"
+
+#define LINE_MAX 256
+#define PROGRAM_MAX 4096
+#define LABELS_MAX 64
+#define LOCALS_MAX 100
+#define FIXUPS_MAX 64
+#define MACROS_MAX 8
+#define MACRO_LINES_MAX 128
+#define MACRO_PARAMS_MAX 8
+#define STEPS_MAX 100000
+
+#define AVR_ARITH (AVR_C | AVR_Z | AVR_N | AVR_V | AVR_S)
+#define AVR_LOGIC (AVR_Z | AVR_N | AVR_V | AVR_S)
+
+typedef enum op {
+	OP_ADD, OP_ADC, OP_SUB, OP_SBC, OP_SUBI, OP_SBCI, OP_CP, OP_CPC, OP_CPI,
+	OP_AND, OP_OR, OP_EOR, OP_COM, OP_NEG, OP_INC, OP_DEC,
+	OP_ASR, OP_LSR, OP_ROR, OP_MOV, OP_MOVW, OP_LDI, OP_MUL,
+	OP_SBRC, OP_SBRS, OP_BRANCH, OP_RJMP, OP_RET, OP_STZ
+} op_t;
+
+/* operands as written: two registers, register and constant, one register
+ * that is both operands (CLR, LSL, ROL, TST), a label, none, Z+ and a register */
+typedef enum form {
+	FORM_RR, FORM_RK, FORM_R, FORM_RSAME, FORM_LABEL, FORM_NONE, FORM_STZ
+} form_t;
+
+typedef struct mnemonic {
+	const char *name;
+	op_t op;
+	form_t form;
+	/* branches: taken when this SREG bit is set (or clear) */
+	uint8_t flag;
+	bool set;
+} mnemonic_t;
+
+typedef struct insn {
+	op_t op;
+	uint8_t d;
+	uint8_t r;
+	long k;
+	int target;
+	uint8_t flag;
+	bool set;
+} insn_t;
+
+typedef struct label {
+	char name[32];
+	int index;
+} label_t;
+
+/* a forward reference to a numeric label */
+typedef struct fixup {
+	int number;
+	int insn;
+} fixup_t;
+
+typedef struct macro {
+	char name[32];
+	char params[MACRO_PARAMS_MAX][16];
+	int param_count;
+	char *lines[MACRO_LINES_MAX];
+	int line_count;
+} macro_t;
+
+static const mnemonic_t mnemonics[] = {
+	{ "add", OP_ADD, FORM_RR }, { "adc", OP_ADC, FORM_RR },
+	{ "sub", OP_SUB, FORM_RR }, { "sbc", OP_SBC, FORM_RR },
+	{ "subi", OP_SUBI, FORM_RK }, { "sbci", OP_SBCI, FORM_RK },
+	{ "cp", OP_CP, FORM_RR }, { "cpc", OP_CPC, FORM_RR }, { "cpi", OP_CPI, FORM_RK },
+	{ "and", OP_AND, FORM_RR }, { "or", OP_OR, FORM_RR }, { "eor", OP_EOR, FORM_RR },
+	{ "clr", OP_EOR, FORM_RSAME }, { "tst", OP_AND, FORM_RSAME },
+	{ "lsl", OP_ADD, FORM_RSAME }, { "rol", OP_ADC, FORM_RSAME },
+	{ "com", OP_COM, FORM_R }, { "neg", OP_NEG, FORM_R },
+	{ "inc", OP_INC, FORM_R }, { "dec", OP_DEC, FORM_R },
+	{ "asr", OP_ASR, FORM_R }, { "lsr", OP_LSR, FORM_R }, { "ror", OP_ROR, FORM_R },
+	{ "mov", OP_MOV, FORM_RR }, { "movw", OP_MOVW, FORM_RR },
+	{ "ldi", OP_LDI, FORM_RK }, { "mul", OP_MUL, FORM_RR },
+	{ "sbrc", OP_SBRC, FORM_RK }, { "sbrs", OP_SBRS, FORM_RK },
+	{ "breq", OP_BRANCH, FORM_LABEL, AVR_Z, true }, { "brne", OP_BRANCH, FORM_LABEL, AVR_Z, false },
+	{ "brcs", OP_BRANCH, FORM_LABEL, AVR_C, true }, { "brcc", OP_BRANCH, FORM_LABEL, AVR_C, false },
+	{ "brlo", OP_BRANCH, FORM_LABEL, AVR_C, true }, { "brsh", OP_BRANCH, FORM_LABEL, AVR_C, false },
+	{ "brmi", OP_BRANCH, FORM_LABEL, AVR_N, true }, { "brpl", OP_BRANCH, FORM_LABEL, AVR_N, false },
+	{ "brvs", OP_BRANCH, FORM_LABEL, AVR_V, true }, { "brvc", OP_BRANCH, FORM_LABEL, AVR_V, false },
+	{ "brlt", OP_BRANCH, FORM_LABEL, AVR_S, true }, { "brge", OP_BRANCH, FORM_LABEL, AVR_S, false },
+	{ "rjmp", OP_RJMP, FORM_LABEL }, { "ret", OP_RET, FORM_NONE },
+	{ "st", OP_STZ, FORM_STZ },
+};
+
+static insn_t program[PROGRAM_MAX];
+static int program_count;
+static label_t labels[LABELS_MAX];
+static int label_count;
+static int locals[LOCALS_MAX];
+static fixup_t fixups[FIXUPS_MAX];
+static int fixup_count;
+static macro_t macros[MACROS_MAX];
+static int macro_count;
+
+/* file:line of the line being assembled, for the messages */
+static const char *source;
+static int source_line;
+
+static bool Error(const char *what, const char *text)
+{
+	fprintf(stderr, "%s:%d: %s: %s\n", source, source_line, what, text);
+	return false;
+}
+
+static const char *Skip(const char *s)
+{
+	while (isspace((unsigned char)*s))
+		s++;
+	return s;
+}
+
+static bool Compare(const char **s, long *v);
+
+static bool Primary(const char **s, long *v)
+{
+	const char *p = Skip(*s);
+	char *end;
+
+	if (*p == '(')
+	{
+		p++;
+		if (!Compare(&p, v))
+			return false;
+		p = Skip(p);
+		if (*p != ')')
+			return false;
+		*s = p + 1;
+		return true;
+	}
+	if (*p == '-')
+	{
+		p++;
+		if (!Primary(&p, v))
+			return false;
+		*v = -*v;
+		*s = p;
+		return true;
+	}
+	if (strncmp(p, "lo8(", 4) == 0 || strncmp(p, "hi8(", 4) == 0)
+	{
+		bool hi = p[0] == 'h';
+
+		p += 3;
+		if (!Primary(&p, v))
+			return false;
+		*v = (hi ? *v >> 8 : *v) & 0xFF;
+		*s = p;
+		return true;
+	}
+	if (!isdigit((unsigned char)*p))
+		return false;
+	*v = strtol(p, &end, 0);
+	*s = end;
+	return true;
+}
+
+static bool Sum(const char **s, long *v)
+{
+	long w;
+
+	if (!Primary(s, v))
+		return false;
+	for (;;)
+	{
+		const char *p = Skip(*s);
+
+		if (*p != '+' && *p != '-')
+			return true;
+		*s = p + 1;
+		if (!Primary(s, &w))
+			return false;
+		*v = *p == '+' ? *v + w : *v - w;
+	}
+}
+
+static bool Compare(const char **s, long *v)
+{
+	const char *p;
+	long w;
+
+	if (!Sum(s, v))
+		return false;
+	p = Skip(*s);
+	if (*p != '<')
+		return true;
+	*s = p + 1;
+	if (!Sum(s, &w))
+		return false;
+	*v = *v < w;
+	return true;
+}
+
+/* a whole operand as a number */
+static bool Value(const char *text, long *v)
+{
+	const char *p = text;
+
+	return Compare(&p, v) && *Skip(p) == '\0';
+}
+
+static bool Register(const char *text, uint8_t *reg)
+{
+	char *end;
+	long n;
+
+	if (text[0] != 'r' || !isdigit((unsigned char)text[1]))
+		return Error("not a register", text);
+	n = strtol(text + 1, &end, 10);
+	if (*end || n > 31)
+		return Error("not a register", text);
+	*reg = n;
+	return true;
+}
+
+static label_t *FindLabel(const char *name)
+{
+	for (int i = 0; i < label_count; ++i)
+		if (strcmp(labels[i].name, name) == 0)
+			return &labels[i];
+	return NULL;
+}
+
+static bool DefineLabel(const char *name)
+{
+	if (isdigit((unsigned char)name[0]))
+	{
+		int number = atoi(name);
+
+		if (number >= LOCALS_MAX)
+			return Error("local label too large", name);
+		locals[number] = program_count;
+		/* forward references to it end here */
+		for (int i = 0; i < fixup_count; ++i)
+		{
+			if (fixups[i].number != number)
+				continue;
+			program[fixups[i].insn].target = program_count;
+			fixups[i--] = fixups[--fixup_count];
+		}
+		return true;
+	}
+	if (FindLabel(name) || label_count == LABELS_MAX || strlen(name) >= sizeof(labels[0].name))
+		return Error("bad or duplicate label", name);
+	strcpy(labels[label_count].name, name);
+	labels[label_count++].index = program_count;
+	return true;
+}
+
+/* the instruction a branch goes to, a numeric local label: the hand coded
+ * functions do not branch between each other */
+static bool Target(const char *text, insn_t *insn)
+{
+	size_t len = strlen(text);
+
+	if (len > 1 && isdigit((unsigned char)text[0]) && (text[len - 1] == 'f' || text[len - 1] == 'b'))
+	{
+		int number = atoi(text);
+
+		if (number >= LOCALS_MAX)
+			return Error("local label too large", text);
+		if (text[len - 1] == 'b')
+		{
+			if (locals[number] < 0)
+				return Error("no such label", text);
+			insn->target = locals[number];
+			return true;
+		}
+		if (fixup_count == FIXUPS_MAX)
+			return Error("too many forward references", text);
+		fixups[fixup_count].number = number;
+		fixups[fixup_count++].insn = program_count;
+		return true;
+	}
+	return Error("only local labels are branch targets", text);
+}
+
+static bool Instruction(char *text)
+{
+	char *operand[3] = { NULL, NULL, NULL };
+	int operands = 0;
+	const mnemonic_t *m = NULL;
+	insn_t insn = { 0 };
+	char *p = text;
+	char *name = text;
+
+	while (*p && !isspace((unsigned char)*p))
+		p++;
+	if (*p)
+		*p++ = '\0';
+	for (size_t i = 0; i < sizeof(mnemonics) / sizeof(mnemonics[0]); ++i)
+		if (strcmp(mnemonics[i].name, name) == 0)
+			m = &mnemonics[i];
+	if (!m)
+		return Error("instruction not in the model", name);
+
+	/* operands separated by commas, blanks trimmed */
+	p = (char *)Skip(p);
+	while (*p && operands < 3)
+	{
+		char *comma = strchr(p, ',');
+		char *end;
+
+		operand[operands++] = p;
+		if (comma)
+			*comma = '\0';
+		end = p + strlen(p);
+		while (end > p && isspace((unsigned char)end[-1]))
+			*--end = '\0';
+		p = comma ? (char *)Skip(comma + 1) : p + strlen(p);
+	}
+	if (program_count == PROGRAM_MAX)
+		return Error("program too long", name);
+
+	insn.op = m->op;
+	insn.flag = m->flag;
+	insn.set = m->set;
+	switch (m->form)
+	{
+	case FORM_RR:
+		if (operands != 2 || !Register(operand[0], &insn.d) || !Register(operand[1], &insn.r))
+			return Error("needs two registers", name);
+		if (m->op == OP_MOVW && (insn.d & 1 || insn.r & 1))
+			return Error("odd register", name);
+		break;
+	case FORM_RK:
+		if (operands != 2 || !Register(operand[0], &insn.d) || !Value(operand[1], &insn.k))
+			return Error("needs a register and a constant", name);
+		if (m->op == OP_SBRC || m->op == OP_SBRS)
+		{
+			if (insn.k < 0 || insn.k > 7)
+				return Error("bit out of range", operand[1]);
+		}
+		else if (insn.d < 16 || insn.k < -128 || insn.k > 255)
+			return Error("needs r16..r31 and a byte", name);
+		break;
+	case FORM_R:
+	case FORM_RSAME:
+		if (operands != 1 || !Register(operand[0], &insn.d))
+			return Error("needs one register", name);
+		insn.r = insn.d;
+		break;
+	case FORM_LABEL:
+		if (operands != 1 || !Target(operand[0], &insn))
+			return Error("needs a label", name);
+		break;
+	case FORM_NONE:
+		if (operands != 0)
+			return Error("takes no operands", name);
+		break;
+	case FORM_STZ:
+		/* only ST Z+, the store of the firmware's hand coded functions */
+		if (operands != 2 || strcmp(operand[0], "Z+") != 0 || !Register(operand[1], &insn.r))
+			return Error("only st Z+, r is in the model", name);
+		break;
+	}
+	program[program_count++] = insn;
+	return true;
+}
+
+static macro_t *FindMacro(const char *name)
+{
+	for (int i = 0; i < macro_count; ++i)
+		if (strcmp(macros[i].name, name) == 0)
+			return &macros[i];
+	return NULL;
+}
+
+static bool Lines(char **lines, int count);
+
+/* a macro call: the body with every \param replaced by its argument */
+static bool Expand(macro_t *m, char *args)
+{
+	char *arg[MACRO_PARAMS_MAX];
+	char *body[MACRO_LINES_MAX];
+	int n = 0;
+	bool ok;
+
+	while (n < m->param_count)
+	{
+		char *comma = strchr(args, ',');
+
+		arg[n++] = (char *)Skip(args);
+		if (comma)
+			*comma = '\0';
+		if (!comma)
+			break;
+		args = comma + 1;
+	}
+	if (n != m->param_count)
+		return Error("wrong number of macro arguments", m->name);
+
+	for (int i = 0; i < m->line_count; ++i)
+	{
+		char out[LINE_MAX] = "";
+		const char *p = m->lines[i];
+
+		while (*p)
+		{
+			int j = 0;
+
+			if (*p == '\\')
+				for (j = 0; j < m->param_count; ++j)
+					if (strncmp(p + 1, m->params[j], strlen(m->params[j])) == 0 &&
+					    !isalnum((unsigned char)p[1 + strlen(m->params[j])]))
+						break;
+			if (*p == '\\' && j < m->param_count)
+			{
+				strncat(out, arg[j], sizeof(out) - strlen(out) - 1);
+				p += 1 + strlen(m->params[j]);
+			}
+			else
+				strncat(out, p++, 1);
+		}
+		body[i] = strdup(out);
+	}
+	ok = Lines(body, m->line_count);
+	for (int i = 0; i < m->line_count; ++i)
+		free(body[i]);
+	return ok;
+}
+
+/* The end of the .rept or .if block that starts at lines[first]: the index
+ * of its .endr or .endif, and of its .else if it has one. */
+static int BlockEnd(char **lines, int count, int first, int *otherwise)
+{
+	int depth = 0;
+
+	*otherwise = -1;
+	for (int i = first; i < count; ++i)
+	{
+		const char *d = lines[i];
+
+		if (strncmp(d, ".rept", 5) == 0 || strncmp(d, ".if", 3) == 0)
+			depth++;
+		else if (strncmp(d, ".endr", 5) == 0 || strncmp(d, ".endif", 6) == 0)
+		{
+			if (--depth == 0)
+				return i;
+		}
+		else if (strncmp(d, ".else", 5) == 0 && depth == 1)
+			*otherwise = i;
+	}
+	return -1;
+}
+
+/* Assembles lines, comments already gone and blanks trimmed. */
+static bool Lines(char **lines, int count)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		char text[LINE_MAX];
+		char *p = text;
+		char *colon;
+		macro_t *m;
+
+		strncpy(text, lines[i], sizeof(text) - 1);
+		text[sizeof(text) - 1] = '\0';
+		if (!text[0])
+			continue;
+
+		if (strncmp(text, ".macro", 6) == 0)
+		{
+			char *name;
+
+			if (macro_count == MACROS_MAX)
+				return Error("too many macros", text);
+			m = &macros[macro_count++];
+			memset(m, 0, sizeof(*m));
+			name = strtok(text + 6, " \t,");
+			if (!name || strlen(name) >= sizeof(m->name))
+				return Error("bad macro", lines[i]);
+			strcpy(m->name, name);
+			while ((name = strtok(NULL, " \t,")) && m->param_count < MACRO_PARAMS_MAX)
+				snprintf(m->params[m->param_count++], sizeof(m->params[0]), "%s", name);
+			while (++i < count && strcmp(lines[i], ".endm") != 0)
+			{
+				if (m->line_count == MACRO_LINES_MAX)
+					return Error("macro too long", m->name);
+				m->lines[m->line_count++] = strdup(lines[i]);
+			}
+			continue;
+		}
+		if (strncmp(text, ".rept", 5) == 0 || strncmp(text, ".if", 3) == 0)
+		{
+			int otherwise;
+			int end = BlockEnd(lines, count, i, &otherwise);
+			long v;
+
+			if (end < 0 || !Value(text + (text[1] == 'r' ? 5 : 3), &v))
+				return Error("bad block", text);
+			if (text[1] == 'r')
+			{
+				while (v-- > 0)
+					if (!Lines(lines + i + 1, end - i - 1))
+						return false;
+			}
+			else if (v)
+			{
+				if (!Lines(lines + i + 1, (otherwise < 0 ? end : otherwise) - i - 1))
+					return false;
+			}
+			else if (otherwise >= 0 && !Lines(lines + otherwise + 1, end - otherwise - 1))
+				return false;
+			i = end;
+			continue;
+		}
+		if (text[0] == '.')
+			continue;
+
+		/* "label:" first, then maybe an instruction */
+		colon = strchr(text, ':');
+		if (colon && colon > text && strspn(text, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_") ==
+		                                 (size_t)(colon - text))
+		{
+			*colon = '\0';
+			if (!DefineLabel(text))
+				return false;
+			p = (char *)Skip(colon + 1);
+			if (!*p)
+				continue;
+		}
+
+		/* a macro call or an instruction */
+		colon = p;
+		while (*colon && !isspace((unsigned char)*colon))
+			colon++;
+		if (*colon)
+			*colon++ = '\0';
+		m = FindMacro(p);
+		if (m)
+		{
+			if (!Expand(m, colon))
+				return false;
+			continue;
+		}
+		if (*colon)
+			colon[-1] = ' ';
+		if (!Instruction(p))
+			return false;
+	}
+	return true;
+}
+
+bool avrasm_load(const char *file)
+{
+	FILE *f = fopen(file, "r");
+	char line[LINE_MAX];
+	char **lines = NULL;
+	int count = 0;
+	bool ok;
+
+	if (!f)
+	{
+		perror(file);
+		return false;
+	}
+	program_count = label_count = fixup_count = macro_count = 0;
+	memset(locals, 0xFF, sizeof(locals));
+
+	/* comments and blanks off; empty lines stay for the line numbers */
+	while (fgets(line, sizeof(line), f))
+	{
+		char *end = strchr(line, ';');
+		char *p;
+
+		if (end)
+			*end = '\0';
+		if ((end = strstr(line, "//")))
+			*end = '\0';
+		if (line[0] == '#')
+			line[0] = '\0';
+		p = (char *)Skip(line);
+		end = p + strlen(p);
+		while (end > p && isspace((unsigned char)end[-1]))
+			*--end = '\0';
+		lines = realloc(lines, (count + 1) * sizeof(char *));
+		lines[count++] = strdup(p);
+	}
+	fclose(f);
+
+	/* one line at a time so the messages know where */
+	source = file;
+	ok = true;
+	for (int i = 0; ok && i < count; ++i)
+	{
+		int n = 1;
+
+		source_line = i + 1;
+		if (strncmp(lines[i], ".macro", 6) == 0)
+			while (i + n < count && strcmp(lines[i + n - 1], ".endm") != 0)
+				n++;
+		else if (strncmp(lines[i], ".rept", 5) == 0 || strncmp(lines[i], ".if", 3) == 0)
+		{
+			int otherwise;
+			int end = BlockEnd(lines, count, i, &otherwise);
+
+			n = end < 0 ? 1 : end - i + 1;
+		}
+		ok = Lines(lines + i, n);
+		i += n - 1;
+	}
+	if (ok && fixup_count)
+		ok = Error("forward reference without its label", "");
+	for (int i = 0; i < count; ++i)
+		free(lines[i]);
+	free(lines);
+	return ok;
+}
+
+static void Sreg(avr_cpu_t *cpu, uint8_t mask, bool c, bool z, bool n, bool v)
+{
+	uint8_t s = (c ? AVR_C : 0) | (z ? AVR_Z : 0) | (n ? AVR_N : 0) | (v ? AVR_V : 0) | (n != v ? AVR_S : 0);
+
+	cpu->sreg = (cpu->sreg & ~mask) | (s & mask);
+}
+
+static uint8_t Add(avr_cpu_t *cpu, uint8_t a, uint8_t b, bool carry)
+{
+	unsigned sum = a + b + (carry && (cpu->sreg & AVR_C) ? 1 : 0);
+	uint8_t res = sum;
+
+	Sreg(cpu, AVR_ARITH, sum > 0xFF, res == 0, res & 0x80, ~(a ^ b) & (a ^ res) & 0x80);
+	return res;
+}
+
+/* SBC, SBCI and CPC keep Z clear once a byte was not zero */
+static uint8_t Sub(avr_cpu_t *cpu, uint8_t a, uint8_t b, bool carry)
+{
+	unsigned borrow = carry && (cpu->sreg & AVR_C) ? 1 : 0;
+	uint8_t res = a - b - borrow;
+	bool z = res == 0 && (!carry || (cpu->sreg & AVR_Z));
+
+	Sreg(cpu, AVR_ARITH, a < b + borrow, z, res & 0x80, (a ^ b) & (a ^ res) & 0x80);
+	return res;
+}
+
+static uint8_t Logic(avr_cpu_t *cpu, uint8_t res)
+{
+	Sreg(cpu, AVR_LOGIC, false, res == 0, res & 0x80, false);
+	return res;
+}
+
+/* ASR, LSR and ROR: bit 0 to C */
+static uint8_t Shift(avr_cpu_t *cpu, uint8_t a, uint8_t top)
+{
+	uint8_t res = a >> 1 | top;
+	bool c = a & 1;
+
+	Sreg(cpu, AVR_ARITH, c, res == 0, res & 0x80, ((res & 0x80) != 0) != c);
+	return res;
+}
+
+bool avrasm_call(avr_cpu_t *cpu, const char *symbol)
+{
+	label_t *entry = FindLabel(symbol);
+	uint8_t *r = cpu->r;
+	int pc;
+
+	if (!entry)
+	{
+		fprintf(stderr, "avrasm: no %s\n", symbol);
+		return false;
+	}
+	pc = entry->index;
+	cpu->cycles += 4;
+
+	for (long steps = 0; steps < STEPS_MAX; ++steps)
+	{
+		const insn_t *i;
+		uint8_t d;
+		uint8_t v;
+		unsigned z;
+
+		if (pc < 0 || pc >= program_count)
+			break;
+		i = &program[pc++];
+		d = r[i->d];
+		v = r[i->r];
+		cpu->cycles++;
+
+		switch (i->op)
+		{
+		case OP_ADD: r[i->d] = Add(cpu, d, v, false); break;
+		case OP_ADC: r[i->d] = Add(cpu, d, v, true); break;
+		case OP_SUB: r[i->d] = Sub(cpu, d, v, false); break;
+		case OP_SBC: r[i->d] = Sub(cpu, d, v, true); break;
+		case OP_SUBI: r[i->d] = Sub(cpu, d, i->k, false); break;
+		case OP_SBCI: r[i->d] = Sub(cpu, d, i->k, true); break;
+		case OP_CP: Sub(cpu, d, v, false); break;
+		case OP_CPC: Sub(cpu, d, v, true); break;
+		case OP_CPI: Sub(cpu, d, i->k, false); break;
+		case OP_AND: r[i->d] = Logic(cpu, d & v); break;
+		case OP_OR: r[i->d] = Logic(cpu, d | v); break;
+		case OP_EOR: r[i->d] = Logic(cpu, d ^ v); break;
+		case OP_COM:
+			r[i->d] = ~d;
+			Sreg(cpu, AVR_ARITH, true, r[i->d] == 0, r[i->d] & 0x80, false);
+			break;
+		case OP_NEG:
+			r[i->d] = -d;
+			Sreg(cpu, AVR_ARITH, r[i->d] != 0, r[i->d] == 0, r[i->d] & 0x80, r[i->d] == 0x80);
+			break;
+		case OP_INC:
+			r[i->d] = d + 1;
+			Sreg(cpu, AVR_LOGIC, false, r[i->d] == 0, r[i->d] & 0x80, r[i->d] == 0x80);
+			break;
+		case OP_DEC:
+			r[i->d] = d - 1;
+			Sreg(cpu, AVR_LOGIC, false, r[i->d] == 0, r[i->d] & 0x80, r[i->d] == 0x7F);
+			break;
+		case OP_ASR: r[i->d] = Shift(cpu, d, d & 0x80); break;
+		case OP_LSR: r[i->d] = Shift(cpu, d, 0); break;
+		case OP_ROR: r[i->d] = Shift(cpu, d, cpu->sreg & AVR_C ? 0x80 : 0); break;
+		case OP_MOV: r[i->d] = v; break;
+		case OP_MOVW:
+			r[i->d] = v;
+			r[i->d + 1] = r[i->r + 1];
+			break;
+		case OP_LDI: r[i->d] = i->k; break;
+		case OP_MUL:
+			z = d * v;
+			r[0] = z;
+			r[1] = z >> 8;
+			Sreg(cpu, AVR_C | AVR_Z, z & 0x8000, z == 0, false, false);
+			cpu->cycles++;
+			break;
+		case OP_SBRC:
+		case OP_SBRS:
+			/* every instruction of the model is one word */
+			if (!(d >> i->k & 1) == (i->op == OP_SBRC))
+			{
+				pc++;
+				cpu->cycles++;
+			}
+			break;
+		case OP_BRANCH:
+			if (!(cpu->sreg & i->flag) != i->set)
+			{
+				pc = i->target;
+				cpu->cycles++;
+			}
+			break;
+		case OP_RJMP:
+			pc = i->target;
+			cpu->cycles++;
+			break;
+		case OP_RET:
+			cpu->cycles += 4;
+			return true;
+		case OP_STZ:
+			z = r[30] | r[31] << 8;
+			if (z >= sizeof(cpu->data))
+			{
+				fprintf(stderr, "avrasm: %s stores to 0x%04x\n", symbol, z);
+				return false;
+			}
+			cpu->data[z++] = v;
+			r[30] = z;
+			r[31] = z >> 8;
+			break;
+		}
+	}
+	fprintf(stderr, "avrasm: %s did not return\n", symbol);
+	return false;
+}
@@ -0,0 +1,44 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+/* AVR assembly on the host, for the hand coded functions of the firmware
+ * (make host). See host/avrasm.c for what it understands. */
+
+#ifndef HOST_AVRASM_H
+#define HOST_AVRASM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* SREG bits */
+#define AVR_C 0x01
+#define AVR_Z 0x02
+#define AVR_N 0x04
+#define AVR_V 0x08
+#define AVR_S 0x10
+
+typedef struct avr_cpu {
+	uint8_t r[32];
+	uint8_t sreg;
+	/* data space up to the end of the internal SRAM of the ATxmega256A3U */
+	uint8_t data[0x6000];
+	/* XMEGA cycles, the CALL into the function and its RET included */
+	unsigned long cycles;
+} avr_cpu_t;
+
+/*! \brief Assembles file, false with a message on stderr if it cannot. */
+bool avrasm_load(const char *file);
+
+/*! \brief Runs the function at symbol to its RET, adding to cpu->cycles.
+ *
+ *  \retval false  no such symbol, an instruction the model does not have or
+ *                 more than 100000 instructions, with a message on stderr
+ */
+bool avrasm_call(avr_cpu_t *cpu, const char *symbol);
+
+#endif
@@ -0,0 +1,1033 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+/* Host test and benchmark runner, built and run by 'make host'.
+ *
+ * Links the firmware sources against the register model in host/ and plays
+ * the hardware: it fills USART DATA and calls the RXC ISR, collects DATA
+ * after every DRE ISR, moves the chunks of the UART D0 transmit DMA channel,
+ * calls TCC0_OVF_vect for every step and feeds reference edges to the
+ * capture ISR of pps.c. The telemetry frames it collects are decoded by
+ * tools/telemetry_decode, which 'make host' builds too. Exits with
+ * the number of failed checks.
+ *
+ * 'host/bench trace.vcd' also writes the PORTD and DACB outputs of a few
+ * rotations of this model as a VCD file for a waveform viewer (make trace).
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <util/crc16.h>
+
+#include "avr_compiler.h"
+#include "usart_driver.h"
+/* UART D0 transmits by DMA CH1, as a build with COMMUTATION_MODE_ISR could */
+#define ENABLE_UART_D0		1
+#define UART_D0_RX_SIZE		2
+#define UART_D0_TX_SIZE		16
+#define UART_TX_DMA_D0		1
+#include "uart.h"
+#include "antennas.h"
+#include "commutation.h"
+#include "clock.h"
+#include "cordic.h"
+#include "pps.h"
+#include "telemetry.h"
+#include "avrasm.h"
+
+/* Instantiated by uart.h in main.c (ENABLE_UART_F0, 64/256 byte buffers). */
+extern USART_data_t uartF0;
+void USARTF0_RXC_vect(void);
+void USARTF0_DRE_vect(void);
+void TCC0_OVF_vect(void);
+void OSC_OSCF_vect(void);
+void TCC1_CCB_vect(void);
+
+/* compile time baud rate settings, checked against uart_calc_baud() */
+#define BAUD 230400UL
+#include "uart_baud.h"
+
+#define RING_ROUNDS 200000
+#define STEP_ROUNDS 1000000
+
+static unsigned failures;
+
+#define CHECK(cond, ...)                                                   \
+	do {                                                                   \
+		if (!(cond))                                                       \
+		{                                                                  \
+			failures++;                                                    \
+			printf("FAIL %s:%d: ", __FILE__, __LINE__);                    \
+			printf(__VA_ARGS__);                                           \
+			putchar('\n');                                                 \
+		}                                                                  \
+	} while (0)
+
+static double Now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Bytes through the transmit and receive rings of UART F0 by way of the ISRs. */
+static void Ring(void)
+{
+	uint8_t buf[64];
+	uint8_t next = 0;
+	uint8_t expect = 0;
+	uint16_t tx;
+	uint16_t rx;
+	double t;
+
+	init_uart(&uartF0, &USARTF0, BAUD_SETTING);
+	uart_set_policy(&uartF0, UART_DROP_NEWEST);
+
+	t = Now();
+	for (long round = 0; round < RING_ROUNDS; ++round)
+	{
+		uint16_t n;
+
+		for (uint8_t i = 0; i < sizeof(buf); ++i)
+			buf[i] = next++;
+		n = uart_write(&uartF0, buf, sizeof(buf));
+		CHECK(n == sizeof(buf), "uart_write took %u of %u bytes", n, (unsigned)sizeof(buf));
+		for (uint16_t i = 0; i < n; ++i)
+		{
+			USARTF0_DRE_vect();
+			CHECK(USARTF0.DATA == expect, "sent %u, expected %u", USARTF0.DATA, expect);
+			expect++;
+		}
+		USARTF0_DRE_vect();
+		CHECK(!(USARTF0.CTRLA & USART_DREINTLVL_gm), "DRE interrupt still on with an empty buffer");
+	}
+	t = Now() - t;
+	printf("ring  tx: %.1f MB/s through uart_write and the DRE ISR\n",
+	       RING_ROUNDS * sizeof(buf) / t / 1e6);
+
+	expect = next;
+	t = Now();
+	for (long round = 0; round < RING_ROUNDS; ++round)
+	{
+		uint16_t n;
+
+		for (uint8_t i = 0; i < 32; ++i)
+		{
+			USARTF0.DATA = next++;
+			USARTF0_RXC_vect();
+		}
+		n = uart_read(&uartF0, buf, sizeof(buf));
+		CHECK(n == 32, "uart_read got %u of 32 bytes", n);
+		for (uint16_t i = 0; i < n; ++i, ++expect)
+			CHECK(buf[i] == expect, "received %u, expected %u", buf[i], expect);
+	}
+	t = Now() - t;
+	printf("ring  rx: %.1f MB/s through the RXC ISR and uart_read\n",
+	       RING_ROUNDS * 32.0 / t / 1e6);
+
+	/* one slot of the ring stays empty */
+	for (uint8_t i = 0; i < 100; ++i)
+	{
+		USARTF0.DATA = i;
+		USARTF0_RXC_vect();
+	}
+	uart_dropped(&uartF0, &tx, &rx);
+	CHECK(rx == 100 - uartF0.buffer.RX_Mask, "rx dropped %u, expected %u", rx, 100 - uartF0.buffer.RX_Mask);
+	CHECK(uart_read(&uartF0, buf, sizeof(buf)) == uartF0.buffer.RX_Mask, "full receive ring not readable");
+}
+
+/* Plays DMA CH1 for up to \em bytes bytes: moves them from the source to
+ * \em out and raises the transaction complete interrupt at a chunk end. */
+static uint16_t PlayTxDma(uint8_t *out, uint16_t bytes)
+{
+	DMA_CH_t *ch = &DMA.CH1;
+	uint16_t sent = 0;
+
+	while (sent < bytes && (ch->CTRLA & DMA_CH_ENABLE_bm))
+	{
+		uint16_t src = ch->SRCADDR0 | ch->SRCADDR1 << 8;
+
+		out[sent++] = uartD0.buffer.TX[(uint16_t)(src - (uint16_t)(uintptr_t)uartD0.buffer.TX)];
+		src++;
+		ch->SRCADDR0 = (uint8_t)src;
+		ch->SRCADDR1 = (uint8_t)(src >> 8);
+		if (--ch->TRFCNT == 0)
+		{
+			ch->CTRLA &= ~DMA_CH_ENABLE_bm;
+			ch->CTRLB |= DMA_CH_TRNIF_bm;
+			DMA_CH1_vect();
+			/* the flag is cleared by writing it, the model only keeps it */
+			ch->CTRLB &= ~DMA_CH_TRNIF_bm;
+		}
+	}
+	return sent;
+}
+
+/* uart_write through uart_tx_dma: chunks up to the end of the buffer array,
+ * and UART_DROP_OLDEST stopping the channel in the middle of a chunk. */
+static void TxDma(void)
+{
+	uint8_t buf[32];
+	uint8_t out[32];
+	uint8_t expect[15];
+	uint16_t sent;
+	uint16_t tx;
+	uint16_t rx;
+
+	for (uint8_t i = 0; i < sizeof(buf); ++i)
+		buf[i] = i + 1;
+	init_uart(&uartD0, &USARTD0, BAUD_SETTING);
+	uart_tx_dma(&uartD0, UART_TX_DMA_D0);
+	CHECK(DMA.CH1.TRIGSRC == DMA_CH_TRIGSRC_USARTD0_DRE_gc, "DMA trigger %u", DMA.CH1.TRIGSRC);
+	CHECK(!(USARTD0.CTRLA & USART_DREINTLVL_gm), "DRE interrupt on with a DMA channel");
+
+	/* 10 bytes, then 12 that wrap: a chunk of 6 up to the array end and one of 6 */
+	CHECK(uart_write(&uartD0, buf, 10) == 10, "uart_write refused 10 bytes");
+	CHECK(DMA.CH1.TRFCNT == 10, "first chunk %u bytes", DMA.CH1.TRFCNT);
+	sent = PlayTxDma(out, sizeof(out));
+	CHECK(sent == 10 && memcmp(out, buf, 10) == 0, "DMA sent %u of 10 bytes", sent);
+	CHECK(uart_write(&uartD0, buf + 10, 12) == 12, "uart_write refused 12 bytes");
+	CHECK(DMA.CH1.TRFCNT == 6, "chunk to the array end %u bytes", DMA.CH1.TRFCNT);
+	sent = PlayTxDma(out, sizeof(out));
+	CHECK(sent == 12 && memcmp(out, buf + 10, 12) == 0, "DMA sent %u of 12 wrapped bytes", sent);
+	CHECK(!(DMA.CH1.CTRLA & DMA_CH_ENABLE_bm), "DMA channel still on with an empty buffer");
+
+	/* a full buffer, 5 bytes sent, then 8 more: the oldest 8 not sent go */
+	uart_set_policy(&uartD0, UART_DROP_OLDEST);
+	CHECK(uart_write(&uartD0, buf, 15) == 15, "uart_write refused 15 bytes");
+	sent = PlayTxDma(out, 5);
+	CHECK(uart_write(&uartD0, buf + 20, 8) == 8, "uart_write refused 8 bytes");
+	sent += PlayTxDma(out + sent, sizeof(out) - sent);
+	memcpy(expect, buf, 5);
+	memcpy(expect + 5, buf + 13, 2);
+	memcpy(expect + 7, buf + 20, 8);
+	CHECK(sent == sizeof(expect) && memcmp(out, expect, sizeof(expect)) == 0,
+	      "DMA sent %u bytes around the drop, expected %u", sent, (unsigned)sizeof(expect));
+	uart_dropped(&uartD0, &tx, &rx);
+	CHECK(tx == 8, "tx dropped %u, expected 8", tx);
+}
+
+/* Sends what is in the transmit ring of UART F0 through the DRE ISR. */
+static size_t Drain(uint8_t *out)
+{
+	size_t n = 0;
+
+	while (uartF0.buffer.TX_Head != uartF0.buffer.TX_Tail)
+	{
+		USARTF0_DRE_vect();
+		out[n++] = USARTF0.DATA;
+	}
+	USARTF0_DRE_vect();
+	return n;
+}
+
+/* COBS frame of a message with its CRC, for frames too large for the ring. */
+static size_t Frame(const uint8_t *msg, size_t len, uint8_t *out)
+{
+	uint8_t full[TELEMETRY_FRAME_MAX(255)];
+	uint16_t crc = 0;
+	size_t code_index = 0;
+	size_t n = 1;
+	uint8_t code = 1;
+
+	for (size_t i = 0; i < len; ++i)
+		crc = _crc_xmodem_update(crc, msg[i]);
+	memcpy(full, msg, len);
+	full[len] = crc & 0xFF;
+	full[len + 1] = crc >> 8;
+	for (size_t i = 0; i < len + 2; ++i)
+	{
+		if (full[i] != 0)
+			out[n++] = full[i];
+		if (full[i] == 0 || ++code == 0xFF)
+		{
+			out[code_index] = code;
+			code_index = n++;
+			code = 1;
+		}
+	}
+	out[code_index] = code;
+	out[n++] = 0;
+	return n;
+}
+
+/* Sends a frame and drains it into the stream, true when it was queued. */
+static bool Send(telemetry_type_t type, const void *payload, uint8_t len, uint8_t *stream, size_t *n)
+{
+	bool queued = telemetry_send(type, payload, len);
+
+	*n += Drain(stream + *n);
+	return queued;
+}
+
+/* Telemetry frames built in the transmit ring of UART F0, sent by the DRE
+ * ISR and decoded by tools/telemetry_decode: zero bytes in the payload, the
+ * largest frame that fits the 256 byte ring, whole frames dropped when they
+ * do not fit, COBS blocks of 254 bytes and a frame with a bad CRC. */
+static void Telemetry(void)
+{
+	static uint8_t stream[2048];
+	static char output[8192];
+	static char expect[8192];
+	char text[256];
+	char path[] = "/tmp/telemetryXXXXXX";
+	char command[64];
+	uint8_t msg[256];
+	size_t n = 0;
+	size_t e = 0;
+	size_t got;
+	uint8_t head;
+	uint16_t crc = 0;
+	int fd;
+	FILE *f;
+
+	for (const char *p = "123456789"; *p; ++p)
+		crc = _crc_xmodem_update(crc, *p);
+	CHECK(crc == 0x31C3, "CRC-16/XMODEM check value %04X, expected 31C3", crc);
+
+	init_uart(&uartF0, &USARTF0, BAUD_SETTING);
+	telemetry_init(&uartF0);
+	n += Drain(stream + n);
+	CHECK(n == 1 && stream[0] == 0, "telemetry_init sent %u bytes", (unsigned)n);
+
+	CHECK(Send(TELEMETRY_TEXT, "hello", 5, stream, &n), "text frame dropped");
+	e += sprintf(expect + e, "text      hello\n");
+	CHECK(Send(TELEMETRY_ROTATION, "\x07", 1, stream, &n), "rotation frame dropped");
+	e += sprintf(expect + e, "rotation  7\n");
+	memset(msg, 0, 8);
+	CHECK(Send(TELEMETRY_COUNTERS, msg, 8, stream, &n), "counters frame dropped");
+	e += sprintf(expect + e, "counters  uart tx dropped 0 rx dropped 0, frames dropped 0, log dropped 0\n");
+	CHECK(Send(TELEMETRY_TIMESTAMP, "\x03\x00\x23\x01\x00\x00", 6, stream, &n), "timestamp frame dropped");
+	e += sprintf(expect + e, "timestamp rotation 3 at cycle 74496, 0 lost\n");
+
+	/* 250 bytes without a zero: code, 253 bytes and the delimiter fill the ring */
+	for (int i = 0; i < 255; ++i)
+		text[i] = 'a' + i % 26;
+	CHECK(Send(TELEMETRY_TEXT, text, 250, stream, &n), "250 byte text dropped from an empty ring");
+	e += sprintf(expect + e, "text      %.250s\n", text);
+
+	/* one more makes a block of 254 and a code byte more than the ring holds */
+	for (uint16_t len = 251; len <= 255; ++len)
+	{
+		head = uartF0.buffer.TX_Head;
+		CHECK(!telemetry_send(TELEMETRY_TEXT, text, len), "%u byte text queued", len);
+		CHECK(uartF0.buffer.TX_Head == head, "%u byte text: TX_Head moved", len);
+	}
+
+	/* a frame that does not fit behind another one goes whole */
+	CHECK(telemetry_send(TELEMETRY_TEXT, "hello", 5), "text frame dropped");
+	head = uartF0.buffer.TX_Head;
+	CHECK(!telemetry_send(TELEMETRY_TEXT, text, 245), "245 byte text queued behind another frame");
+	CHECK(uartF0.buffer.TX_Head == head, "dropped frame moved TX_Head");
+	n += Drain(stream + n);
+	e += sprintf(expect + e, "text      hello\n");
+	CHECK(telemetry_dropped() == 6, "%u frames dropped, expected 6", telemetry_dropped());
+
+	/* blocks of 254 bytes, too large for the ring, and a bad CRC */
+	for (uint16_t len = 254; len <= 255; ++len)
+	{
+		msg[0] = TELEMETRY_TEXT;
+		memcpy(msg + 1, text, 255);
+		n += Frame(msg, len + 1, stream + n);
+		e += sprintf(expect + e, "text      %.*s\n", len, text);
+	}
+	msg[0] = TELEMETRY_TEXT;
+	memcpy(msg + 1, "hello", 5);
+	got = Frame(msg, 6, stream + n);
+	stream[n + 2] ^= 0x20;
+	n += got;
+	e += sprintf(expect + e, "bad frame (%u bytes), 1 so far\n", (unsigned)got - 1);
+	e += sprintf(expect + e, "8 frames, 1 bad\n");
+
+	fd = mkstemp(path);
+	f = fd < 0 ? NULL : fdopen(fd, "wb");
+	CHECK(f != NULL, "no temporary file for the telemetry stream");
+	if (!f)
+		return;
+	fwrite(stream, 1, n, f);
+	fclose(f);
+	snprintf(command, sizeof(command), "tools/telemetry_decode < %s 2>&1", path);
+	f = popen(command, "r");
+	got = f ? fread(output, 1, sizeof(output) - 1, f) : 0;
+	output[got] = '\0';
+	CHECK(f && pclose(f) == 0, "tools/telemetry_decode failed");
+	unlink(path);
+	CHECK(strcmp(output, expect) == 0, "tools/telemetry_decode printed\n%s\nexpected\n%s", output, expect);
+}
+
+/* Baud rate the hardware makes of BAUDCTRLA/B and CLK2X. */
+static double Baud(USART_t *usart)
+{
+	uint16_t bsel = usart->BAUDCTRLA | (usart->BAUDCTRLB & 0x0F) << 8;
+	int8_t bscale = (int8_t)usart->BAUDCTRLB >> 4;
+	double factor = usart->CTRLB & USART_CLK2X_bm ? 8 : 16;
+
+	if (bscale >= 0)
+		return F_CPU / (factor * (1 << bscale) * (bsel + 1));
+	return F_CPU / (factor * (bsel / (double)(1 << -bscale) + 1));
+}
+
+/* uart_calc_baud() and uart_set_baud() against the rates asked for, up to
+ * 4 Mbaud with CLK2X, and BAUD_SETTING of uart_baud.h against both. */
+static void BaudRates(void)
+{
+	static const uint32_t rates[] = {
+		2400, 9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600, 1000000, 2000000, 4000000
+	};
+	uart_baud_t setting;
+	uart_baud_t kept;
+
+	printf("baud  requested  achieved   error  clk2x bscale  bsel\n");
+	for (uint8_t i = 0; i < sizeof(rates) / sizeof(rates[0]); ++i)
+	{
+		double got;
+
+		USARTF0.CTRLB = USART_RXEN_bm | USART_TXEN_bm;
+		CHECK(uart_calc_baud(F_CPU, rates[i], &setting), "no setting for %lu baud", (unsigned long)rates[i]);
+		uart_set_baud(&uartF0, setting);
+		got = Baud(&USARTF0);
+		printf("      %9lu %9.0f %6.3f%% %6u %6d %5u\n", (unsigned long)rates[i], got,
+		       (got / rates[i] - 1) * 100, setting.clk2x, setting.bscale, setting.bsel);
+		CHECK(got > rates[i] * (1 - BAUD_MAX_ERROR_PPM / 1e6) && got < rates[i] * (1 + BAUD_MAX_ERROR_PPM / 1e6),
+		      "%lu baud is %.0f", (unsigned long)rates[i], got);
+		CHECK(!(USARTF0.CTRLB & USART_CLK2X_bm) == !setting.clk2x, "CLK2X not as set for %lu baud",
+		      (unsigned long)rates[i]);
+		CHECK((USARTF0.CTRLB & (USART_RXEN_bm | USART_TXEN_bm)) == (USART_RXEN_bm | USART_TXEN_bm),
+		      "receiver or transmitter off after setting %lu baud", (unsigned long)rates[i]);
+	}
+	CHECK(uart_calc_baud(F_CPU, 4000000, &setting) && setting.clk2x, "4 Mbaud without CLK2X");
+	kept = setting;
+	CHECK(!uart_calc_baud(F_CPU, 5000000, &setting), "5 Mbaud accepted");
+	CHECK(setting.bsel == kept.bsel && setting.bscale == kept.bscale && setting.clk2x == kept.clk2x,
+	      "refused 5 Mbaud changed the setting to %u/%d/%u", setting.bsel, setting.bscale, setting.clk2x);
+
+	/* what main.c gets at compile time */
+	CHECK(uart_calc_baud(F_CPU, BAUD, &setting), "no setting for %lu baud", BAUD);
+	CHECK(setting.bsel == BAUD_BSEL && setting.bscale == BAUD_BSCALE && setting.clk2x == BAUD_CLK2X,
+	      "BAUD_SETTING %u/%d/%u, uart_calc_baud %u/%d/%u", BAUD_BSEL, BAUD_BSCALE, BAUD_CLK2X,
+	      setting.bsel, setting.bscale, setting.clk2x);
+}
+
+/* The CORDIC of cordic.c written out in wide integers, with its angle table
+ * and gain worked out from atan() and sqrt(): the firmware must give the
+ * same bits. */
+static uint16_t CordicReference(int32_t y, int32_t x, uint32_t *magnitude)
+{
+	int64_t ax = llabs(x);
+	int64_t ay = llabs(y);
+	int64_t max = ax > ay ? ax : ay;
+	int shift = 0;
+	int64_t cx, cy, t;
+	int64_t angle = 0;
+	double gain = 1;
+	uint32_t m;
+
+	*magnitude = 0;
+	if (max == 0)
+		return 0;
+
+	/* to 4096..8191, right shifts round down */
+	while ((max >> shift) >= 8192)
+		shift++;
+	while (shift <= 0 && max * ((int64_t)1 << -shift) < 4096)
+		shift--;
+	cx = shift > 0 ? (int64_t)floor((double)x / ((int64_t)1 << shift)) : (int64_t)x * ((int64_t)1 << -shift);
+	cy = shift > 0 ? (int64_t)floor((double)y / ((int64_t)1 << shift)) : (int64_t)y * ((int64_t)1 << -shift);
+
+	/* left half plane: a quarter turn towards the x axis */
+	if (cx < 0)
+	{
+		t = cx;
+		if (cy >= 0)
+		{
+			cx = cy;
+			cy = -t;
+			angle = 16384;
+		}
+		else
+		{
+			cx = -cy;
+			cy = t;
+			angle = -16384;
+		}
+	}
+
+	for (int i = 0; i < CORDIC_ITERATIONS; ++i)
+	{
+		int64_t d = cy > 0 ? 1 : -1;
+		int64_t step = llround(atan(ldexp(1, -i)) * 32768 / M_PI);
+		int64_t sx = (int64_t)floor(ldexp((double)cy, -i));
+		int64_t sy = (int64_t)floor(ldexp((double)cx, -i));
+
+		cx += d * sx;
+		cy -= d * sy;
+		angle += d * step;
+		gain *= sqrt(1 + ldexp(1, -2 * i));
+	}
+
+	m = (uint64_t)cx * llround(65536 / gain) >> 16;
+	*magnitude = shift > 0 ? m << shift : (m + ((1U << -shift) >> 1)) >> -shift;
+	return (uint16_t)angle;
+}
+
+/* The cycles of cordic_avr.S as stated in cordic.c, with the magnitude and
+ * without: the shortest and the longest path and (0, 0). */
+#define CORDIC_CYCLES_MIN 436
+#define CORDIC_CYCLES_MAX 951
+#define CORDIC_CYCLES_ZERO 40
+#define CORDIC_CYCLES_MIN_NULL 404
+#define CORDIC_CYCLES_MAX_NULL 785
+#define CORDIC_CYCLES_ZERO_NULL 32
+
+static avr_cpu_t cordic_cpu;
+
+/* cordic_avr.S on the AVR model, the magnitude to 0x2100 or not asked for.
+ * False if it broke the avr-gcc calling convention or stored elsewhere. */
+static bool CordicAsm(int32_t y, int32_t x, bool magnitude, uint16_t *angle, uint32_t *m, unsigned long *cycles)
+{
+	avr_cpu_t *cpu = &cordic_cpu;
+	uint8_t saved[32];
+	bool ok = true;
+
+	for (int i = 0; i < 32; ++i)
+		cpu->r[i] = 0xA5 ^ i;
+	cpu->r[1] = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		cpu->r[22 + i] = (uint32_t)y >> 8 * i;
+		cpu->r[18 + i] = (uint32_t)x >> 8 * i;
+	}
+	cpu->r[16] = 0;
+	cpu->r[17] = magnitude ? 0x21 : 0;
+	memset(&cpu->data[0x20FC], 0x5A, 12);
+	cpu->cycles = 0;
+	memcpy(saved, cpu->r, sizeof(saved));
+	if (!avrasm_call(cpu, "cordic_atan2"))
+		return false;
+
+	/* call-saved r2..r17, r28, r29 and a zero r1 */
+	for (int i = 2; i < 30; ++i)
+		if ((i < 18 || i > 27) && cpu->r[i] != saved[i])
+			ok = false;
+	if (cpu->r[1] != 0)
+		ok = false;
+	for (int i = 0x20FC; i < 0x2108; ++i)
+		if ((i < 0x2100 || i > 0x2103 || !magnitude) && cpu->data[i] != 0x5A)
+			ok = false;
+
+	*angle = cpu->r[24] | cpu->r[25] << 8;
+	*m = cpu->data[0x2100] | cpu->data[0x2101] << 8 | cpu->data[0x2102] << 16 | (uint32_t)cpu->data[0x2103] << 24;
+	*cycles = cpu->cycles;
+	return ok;
+}
+
+/* Angle and magnitude of cordic_atan2() against the reference bit for bit
+ * and against atan2() and hypot(): every vector up to 256 and random ones
+ * of every size. The AVR code of cordic_avr.S gives the same bits for every
+ * 13th of them and the ends of the int32_t range, with its cycles. */
+static void Cordic(void)
+{
+	static const int32_t ends[][2] = {
+		{ INT32_MIN, INT32_MIN }, { INT32_MIN, INT32_MAX }, { INT32_MAX, INT32_MIN },
+		{ INT32_MAX, INT32_MAX }, { -1, INT32_MIN }, { INT32_MIN, 0 }, { 1, 0 }, { 0, -1 },
+	};
+	uint64_t seed = 1;
+	double worst_angle = 0;
+	double worst_magnitude = 0;
+	uint32_t mismatches = 0;
+	uint32_t asm_mismatches = 0;
+	unsigned long cycles_min[2] = { ~0UL, ~0UL };
+	unsigned long cycles_max[2] = { 0, 0 };
+	unsigned long cycles;
+	uint16_t asm_a;
+	uint32_t asm_m;
+
+	if (!avrasm_load("cordic_avr.S"))
+	{
+		CHECK(0, "cordic_avr.S not assembled");
+		return;
+	}
+	for (size_t i = 0; i < sizeof(ends) / sizeof(ends[0]); ++i)
+	{
+		uint32_t m;
+		uint16_t a = cordic_atan2(ends[i][0], ends[i][1], &m);
+
+		CHECK(CordicAsm(ends[i][0], ends[i][1], true, &asm_a, &asm_m, &cycles) && asm_a == a && asm_m == m,
+		      "cordic_avr.S (%d, %d): %u/%u, C %u/%u", ends[i][1], ends[i][0], asm_a, asm_m, a, m);
+		if (cycles > cycles_max[1])
+			cycles_max[1] = cycles;
+	}
+
+	for (long n = 0; n < 513L * 513 + 2000000; ++n)
+	{
+		int32_t x, y;
+		uint32_t m, ref_m;
+		uint16_t a, ref_a;
+		double r, e;
+
+		if (n < 513L * 513)
+		{
+			x = n % 513 - 256;
+			y = n / 513 - 256;
+		}
+		else
+		{
+			/* the high bits of a 64 bit LCG, scaled down by 0 to 30 bits */
+			seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+			x = (int32_t)(seed >> 32) >> (seed >> 27 & 31) % 31;
+			seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+			y = (int32_t)(seed >> 32) >> (seed >> 27 & 31) % 31;
+		}
+
+		a = cordic_atan2(y, x, &m);
+		ref_a = CordicReference(y, x, &ref_m);
+		if (a != ref_a || m != ref_m)
+		{
+			if (mismatches++ < 5)
+				CHECK(0, "cordic (%d, %d): %u/%u, reference %u/%u", x, y, a, m, ref_a, ref_m);
+			continue;
+		}
+		if (n % 13 == 0)
+		{
+			/* every other one without the magnitude */
+			bool magnitude = n % 26 == 0;
+
+			if (!CordicAsm(y, x, magnitude, &asm_a, &asm_m, &cycles) || asm_a != a || (magnitude && asm_m != m))
+			{
+				if (asm_mismatches++ < 5)
+					CHECK(0, "cordic_avr.S (%d, %d): %u/%u, C %u/%u", x, y, asm_a, asm_m, a, m);
+			}
+			else if (x == 0 && y == 0)
+				CHECK(cycles == (magnitude ? CORDIC_CYCLES_ZERO : CORDIC_CYCLES_ZERO_NULL),
+				      "cordic_avr.S (0, 0): %lu cycles", cycles);
+			else
+			{
+				if (cycles < cycles_min[magnitude])
+					cycles_min[magnitude] = cycles;
+				if (cycles > cycles_max[magnitude])
+					cycles_max[magnitude] = cycles;
+			}
+		}
+		if (x == 0 && y == 0)
+		{
+			CHECK(a == 0 && m == 0, "cordic (0, 0): %u/%u", a, m);
+			continue;
+		}
+
+		e = fabs(remainder(a - atan2(y, x) * 32768 / M_PI, 65536)) * 360 / 65536;
+		if (e > worst_angle)
+			worst_angle = e;
+		/* relative to the length, plus the rounding of short vectors */
+		r = hypot(x, y);
+		e = fabs(m - r) / (r + 1000);
+		if (e > worst_magnitude)
+			worst_magnitude = e;
+	}
+	CHECK(mismatches == 0, "cordic: %u results differ from the reference", mismatches);
+	CHECK(asm_mismatches == 0, "cordic_avr.S: %u results differ from cordic.c", asm_mismatches);
+	CHECK(cycles_min[1] >= CORDIC_CYCLES_MIN && cycles_max[1] <= CORDIC_CYCLES_MAX,
+	      "cordic_avr.S: %lu..%lu cycles with the magnitude, cordic.c says %u..%u",
+	      cycles_min[1], cycles_max[1], CORDIC_CYCLES_MIN, CORDIC_CYCLES_MAX);
+	CHECK(cycles_min[0] >= CORDIC_CYCLES_MIN_NULL && cycles_max[0] <= CORDIC_CYCLES_MAX_NULL,
+	      "cordic_avr.S: %lu..%lu cycles without the magnitude, cordic.c says %u..%u",
+	      cycles_min[0], cycles_max[0], CORDIC_CYCLES_MIN_NULL, CORDIC_CYCLES_MAX_NULL);
+	CHECK(worst_angle <= 0.5, "cordic: angle off by %.3f degrees", worst_angle);
+	CHECK(worst_magnitude <= 0.002, "cordic: magnitude off by %.3f %% of length + 1000", worst_magnitude * 100);
+	printf("cordic: worst angle %.3f deg, magnitude %.3f %% of length + 1000\n",
+	       worst_angle, worst_magnitude * 100);
+	printf("cordic_avr.S: %lu..%lu cycles, %lu..%lu without the magnitude\n",
+	       cycles_min[1], cycles_max[1], cycles_min[0], cycles_max[0]);
+}
+
+/* Generated pattern tables: a distinct pattern on the table pins and the
+ * marker level of the next antenna for every index. */
+static void Tables(void)
+{
+	static const uint8_t counts[] = { 4, 8, 16 };
+
+	for (uint8_t c = 0; c < sizeof(counts); ++c)
+	{
+		uint8_t n = counts[c];
+		const antenna_table_t *table = antenna_table(n);
+
+		CHECK(table && table->count == n && (1 << table->bits) == n, "no table for %u antennas", n);
+		if (!table)
+			continue;
+		for (uint8_t i = 0; i < n; ++i)
+		{
+			uint8_t port = pgm_read_byte(&table->port[i]);
+			uint16_t dac = pgm_read_word(&table->dac[i]);
+
+			CHECK(port == ANTENNA_PORT_PATTERN(n, i) && (port & ~table->pins) == 0,
+			      "%u antennas, index %u: pattern %u on pins %u", n, i, port, table->pins);
+			for (uint8_t k = 0; k < i; ++k)
+				CHECK(pgm_read_byte(&table->port[k]) != port, "%u antennas: index %u and %u share pattern %u",
+				      n, k, i, port);
+			CHECK(dac == ANTENNA_DAC_LEVEL(n, (i + 1) % n) && dac <= 0xFFF,
+			      "%u antennas, index %u: DAC %u", n, i, dac);
+		}
+	}
+	CHECK(antenna_table(5) == NULL && antenna_table(32) == NULL, "table for an array that is not generated");
+}
+
+/* Antenna and DAC sequence of COMMUTATION_MODE_ISR, one TCC0 overflow per step. */
+static void Sequence(uint8_t antennas, uint8_t rotations)
+{
+	uint8_t first = commutation_rotation();
+
+	for (uint16_t s = 0; s < antennas * rotations; ++s)
+	{
+		uint8_t i = s % antennas;
+
+		TCC0_OVF_vect();
+		CHECK(PORTD.OUT == ANTENNA_PORT_PATTERN(antennas, i),
+		      "%u antennas, step %u: PORTD %u", antennas, s, PORTD.OUT);
+		CHECK(DACB.CH0DATA == ANTENNA_DAC_LEVEL(antennas, (i + 1) % antennas),
+		      "%u antennas, step %u: DAC %u", antennas, s, DACB.CH0DATA);
+		if (i == antennas - 1)
+			CHECK(DACB.CH1DATA == FRAME_CODE_LEVEL(commutation_rotation() & (FRAME_CODE_COUNT - 1)),
+			      "%u antennas, step %u: frame code %u", antennas, s, DACB.CH1DATA);
+		else
+			CHECK(DACB.CH1DATA == 0, "%u antennas, step %u: frame code %u outside the last step",
+			      antennas, s, DACB.CH1DATA);
+	}
+	CHECK((uint8_t)(commutation_rotation() - first) == rotations, "%u rotations counted, expected %u",
+	      (uint8_t)(commutation_rotation() - first), rotations);
+}
+
+/* commutation_trim() by half a timer tick per step: every other rotation a
+ * tick longer per step, back to the plan without trim. */
+static void Trim(void)
+{
+	commutation_plan_t plan;
+	commutation_plan_t slow;
+	uint16_t div;
+	uint16_t longer = 0;
+
+	CHECK(commutation_plan(COMMUTATION_MODE_ISR, F_CPU, 1250000, 4, &plan), "no plan for 1250 Hz");
+	commutation_init(COMMUTATION_MODE_ISR, &plan);
+	div = (double)F_CPU * 1000 / plan.achieved_mhz / (4 * (plan.per + 1)) + 0.5;
+	commutation_trim((int32_t)4 * div * 32768);
+	for (uint8_t r = 0; r < 8; ++r)
+	{
+		for (uint8_t s = 0; s < 4; ++s)
+			TCC0_OVF_vect();
+		CHECK(TCC0.PERBUF == plan.per || TCC0.PERBUF == plan.per + 1,
+		      "trim: PERBUF %u, expected %u or %u", TCC0.PERBUF, plan.per, plan.per + 1);
+		longer += TCC0.PERBUF - plan.per;
+	}
+	CHECK(longer == 4, "trim: %u of 8 rotations longer, expected 4", longer);
+
+	commutation_trim(0);
+	for (uint8_t s = 0; s < 8; ++s)
+		TCC0_OVF_vect();
+	CHECK(TCC0.PERBUF == plan.per, "trim off: PERBUF %u, expected %u", TCC0.PERBUF, plan.per);
+
+	/* 32 cycles per rotation: 8 ticks a step on 4 antennas at DIV1, one
+	 * tick a step on 8 at DIV4 once the new plan runs */
+	commutation_trim((int32_t)32 << 16);
+	for (uint8_t s = 0; s < 4; ++s)
+		TCC0_OVF_vect();
+	CHECK(TCC0.PERBUF == plan.per + 8, "trim at DIV1: PERBUF %u, expected %u", TCC0.PERBUF, plan.per + 8);
+	CHECK(commutation_plan(COMMUTATION_MODE_ISR, F_CPU, 20000, 8, &slow), "no plan for 20 Hz");
+	CHECK(slow.clksel == TC_CLKSEL_DIV4_gc, "20 Hz plan on clksel %u, expected DIV4", slow.clksel);
+	commutation_apply(&slow);
+	for (uint8_t s = 0; s < 4; ++s)
+		TCC0_OVF_vect();
+	CHECK(TCC0.PERBUF == slow.per + 1, "trim at DIV4: PERBUF %u, expected %u", TCC0.PERBUF, slow.per + 1);
+	for (uint8_t s = 0; s < 8; ++s)
+		TCC0_OVF_vect();
+	CHECK(TCC0.PERBUF == slow.per + 1, "trim at DIV4: PERBUF %u, expected %u", TCC0.PERBUF, slow.per + 1);
+}
+
+/* Runs the reference loop for \em seconds with the CPU clock \em ppm fast:
+ * the steps of COMMUTATION_MODE_ISR take PER + 1 cycles, the reference
+ * edges come every PPS_CYCLES of true time, which is a little longer or
+ * shorter in CPU cycles. Edges stop after \em edge_seconds. */
+static void PpsRun(double ppm, uint32_t seconds, uint32_t edge_seconds, pps_status_t *status)
+{
+	const double period = (double)F_CPU / PPS_HZ * (1 + ppm * 1e-6);
+	commutation_plan_t plan;
+	uint64_t now = 0;
+	double edge = 12345;
+	uint32_t edge_number = 0;
+
+	CHECK(commutation_plan(COMMUTATION_MODE_ISR, F_CPU, 1250000, 4, &plan), "no plan for 1250 Hz");
+	commutation_init(COMMUTATION_MODE_ISR, &plan);
+	TCC0.PERBUF = TCC0.PER;
+	pps_init();
+	pps_poll(plan.achieved_mhz);
+
+	while (now < (uint64_t)seconds * F_CPU)
+	{
+		now += TCC0.PER + 1;
+		while (edge <= now && edge_number < edge_seconds * PPS_HZ)
+		{
+			uint32_t t = (uint32_t)edge;
+
+			TCD0.CCB = t >> 16;
+			TCC1.CCB = (uint16_t)t;
+			TCC1_CCB_vect();
+			edge += period;
+			edge_number++;
+		}
+		TCD0.CNT = (uint32_t)now >> 16;
+		TCC1.CNT = (uint16_t)now;
+		pps_poll(plan.achieved_mhz);
+
+		/* the overflow loads the period the last rotation left in PERBUF */
+		TCC0.PER = TCC0.PERBUF;
+		TCC0_OVF_vect();
+		if (PORTD.OUT == ANTENNA_PORT_PATTERN(4, 0))
+		{
+			timebase_stamp_t stamp = { (uint32_t)now, commutation_rotation(), 0 };
+
+			pps_rotation(&stamp);
+		}
+	}
+	pps_status(status);
+}
+
+/* The loop locks the rotation starts onto the edges of a reference the CPU
+ * clock is 20 ppm off from, with the trim lengthening the rotations when
+ * the CPU is fast and shortening them when it is slow, and holds the trim
+ * when the reference goes away. The phase error settles with a time
+ * constant of about 12 edges at PPS_TAU 4. */
+static void Pps(void)
+{
+	/* 20 ppm of the 25600 cycles of a rotation, in 1/65536 cycles */
+	const int32_t trim = 25600 * 20e-6 * 65536;
+	pps_status_t status;
+
+	for (int8_t sign = 1; sign >= -1; sign -= 2)
+	{
+		PpsRun(sign * 20, 100, 100, &status);
+		CHECK(status.state == PPS_LOCKED, "pps %+d ppm: state %u after 100 s", sign * 20, status.state);
+		CHECK(labs(status.phase_error) <= PPS_LOCK_CYCLES, "pps %+d ppm: phase error %ld cycles",
+		      sign * 20, (long)status.phase_error);
+		CHECK(labs(status.clock_ppb - sign * 20000) < 100, "pps %+d ppm: clock %ld ppb",
+		      sign * 20, (long)status.clock_ppb);
+		CHECK(labs(status.trim - sign * trim) < trim / 20, "pps %+d ppm: trim %ld, expected %ld",
+		      sign * 20, (long)status.trim, (long)(sign * trim));
+	}
+
+	PpsRun(20, 110, 100, &status);
+	CHECK(status.state == PPS_NO_SIGNAL, "pps: state %u 10 s after the last edge", status.state);
+	CHECK(labs(status.trim - trim) < trim / 20, "pps: trim %ld held, expected %ld", (long)status.trim, (long)trim);
+}
+
+/* A timer lock the steps can carry is taken, one they can not is refused. */
+static void Lock(void)
+{
+	commutation_plan_t plan;
+
+	CHECK(commutation_plan(COMMUTATION_MODE_ISR, F_CPU, 1250000, 4, &plan), "no plan for 1250 Hz");
+	commutation_init(COMMUTATION_MODE_ISR, &plan);
+	CHECK(commutation_lock_timer(&TCE0, 32), "lock of 32 per rotation on 4 steps refused");
+	CHECK(!commutation_lock_timer(&TCE0, 6), "lock of 6 per rotation on 4 steps taken");
+	CHECK(!commutation_lock_timer(&TCE0, 2), "lock of 2 per rotation on 4 steps taken");
+	CHECK(commutation_plan(COMMUTATION_MODE_NCO, F_CPU, 1250000, 4, &plan), "no NCO plan for 1250 Hz");
+	commutation_init(COMMUTATION_MODE_NCO, &plan);
+	CHECK(!commutation_lock_timer(&TCE0, 32), "lock taken in COMMUTATION_MODE_NCO");
+}
+
+static void Commutation(void)
+{
+	commutation_plan_t plan;
+	double t;
+
+	CHECK(commutation_plan(COMMUTATION_MODE_ISR, F_CPU, 1250000, 4, &plan), "no plan for 1250 Hz");
+	commutation_init(COMMUTATION_MODE_ISR, &plan);
+	Sequence(4, 3);
+
+	/* switched in at the end of the rotation, from antenna 0 of the new array */
+	CHECK(commutation_plan(COMMUTATION_MODE_ISR, F_CPU, 1250000, 8, &plan), "no plan for 8 antennas");
+	TCC0_OVF_vect();
+	commutation_apply(&plan);
+	for (uint8_t s = 1; s < 4; ++s)
+		TCC0_OVF_vect();
+	CHECK(TCC0.PERBUF == plan.per, "PERBUF %u, expected %u", TCC0.PERBUF, plan.per);
+	Sequence(8, 3);
+
+	CHECK(commutation_plan(COMMUTATION_MODE_ISR, F_CPU, 1250000, 16, &plan), "no plan for 16 antennas");
+	commutation_init(COMMUTATION_MODE_ISR, &plan);
+	Sequence(16, 2);
+	Trim();
+
+	t = Now();
+	for (long s = 0; s < STEP_ROUNDS; ++s)
+		TCC0_OVF_vect();
+	t = Now() - t;
+	printf("steps: %.1f ns per TCC0_OVF_vect on this host\n", t / STEP_ROUNDS * 1e9);
+}
+
+/* Antenna of tick t of COMMUTATION_MODE_NCO, from the exact phase t * rate / tick rate. */
+static uint8_t NcoAntenna(uint32_t rotation_mhz, uint8_t antennas, uint32_t t)
+{
+	uint64_t turns = ((unsigned __int128)t * rotation_mhz << 32) / (NCO_TICK_HZ * 1000);
+
+	return (uint8_t)(turns >> 24) * antennas >> 8;
+}
+
+/* Port, DAC and frame code of the accumulator ticks against the exact phase. */
+static void Nco(void)
+{
+	const uint32_t rate = 1234567;
+	commutation_plan_t plan;
+
+	CHECK(commutation_plan(COMMUTATION_MODE_NCO, F_CPU, rate, 8, &plan), "no NCO plan for 1234.567 Hz");
+	commutation_init(COMMUTATION_MODE_NCO, &plan);
+	for (uint32_t t = 1; t < 1000; ++t)
+	{
+		uint8_t next = NcoAntenna(rate, 8, t + 1);
+		uint8_t frame = ((unsigned __int128)(t + 1) * rate << 32) / (NCO_TICK_HZ * 1000) >> 32;
+
+		TCC0_OVF_vect();
+		CHECK(PORTD.OUT == ANTENNA_PORT_PATTERN(8, NcoAntenna(rate, 8, t)), "NCO tick %u: PORTD %u", t, PORTD.OUT);
+		CHECK(DACB.CH0DATA == ANTENNA_DAC_LEVEL(8, next), "NCO tick %u: DAC %u", t, DACB.CH0DATA);
+		CHECK(DACB.CH1DATA == (next == 0 ? FRAME_CODE_LEVEL(frame & (FRAME_CODE_COUNT - 1)) : 0),
+		      "NCO tick %u: frame code %u", t, DACB.CH1DATA);
+	}
+
+	/* a plan switch at the wrap: the DAC level loaded on a tick is still
+	 * the one of the antenna on the next tick */
+	CHECK(commutation_plan(COMMUTATION_MODE_NCO, F_CPU, 2 * rate, 4, &plan), "no NCO plan for 4 antennas");
+	while (PORTD.OUT != ANTENNA_PORT_PATTERN(8, 3))
+		TCC0_OVF_vect();
+	commutation_apply(&plan);
+	{
+		uint8_t antennas = 8;
+		uint16_t dac = DACB.CH0DATA;
+
+		for (uint32_t t = 0; t < 1000; ++t)
+		{
+			TCC0_OVF_vect();
+			if (antennas == 8 && PORTD.OUT == ANTENNA_PORT_PATTERN(8, 0))
+				antennas = 4;
+			CHECK(dac == ANTENNA_DAC_LEVEL(antennas, PORTD.OUT), "NCO switch tick %u: DAC %u on antenna %u of %u",
+			      t, dac, PORTD.OUT, antennas);
+			dac = DACB.CH0DATA;
+		}
+		CHECK(antennas == 4, "NCO plan never switched");
+	}
+}
+
+static void VcdValue(FILE *f, const char *id, uint16_t value, uint8_t bits)
+{
+	fputc('b', f);
+	while (bits--)
+		fputc(value >> bits & 1 ? '1' : '0', f);
+	fprintf(f, " %s\n", id);
+}
+
+/* PORTD.OUT, DACB CH0 and CH1 after every step of 4 antennas at 1250 Hz,
+ * then 8 antennas, at the times TCC0 overflows. */
+static void Trace(const char *file)
+{
+	static const uint16_t prescaler[] = { 0, 1, 2, 4, 8, 64, 256, 1024 };
+	const uint8_t arrays[] = { 4, 8 };
+	FILE *f = fopen(file, "w");
+	uint64_t ps = 0;
+
+	if (!f)
+	{
+		perror(file);
+		failures++;
+		return;
+	}
+	fprintf(f, "$timescale 1ps $end\n$scope module xmega $end\n"
+	        "$var wire 8 d PORTD_OUT $end\n$var wire 12 a DACB_CH0 $end\n$var wire 12 b DACB_CH1 $end\n"
+	        "$upscope $end\n$enddefinitions $end\n");
+	for (uint8_t n = 0; n < sizeof(arrays); ++n)
+	{
+		commutation_plan_t plan;
+
+		CHECK(commutation_plan(COMMUTATION_MODE_ISR, F_CPU, 1250000, arrays[n], &plan),
+		      "no plan for %u antennas", arrays[n]);
+		commutation_init(COMMUTATION_MODE_ISR, &plan);
+		for (uint8_t s = 0; s < arrays[n] * 4; ++s)
+		{
+			TCC0_OVF_vect();
+			fprintf(f, "#%llu\n", (unsigned long long)ps);
+			VcdValue(f, "d", PORTD.OUT, 8);
+			VcdValue(f, "a", DACB.CH0DATA, 12);
+			VcdValue(f, "b", DACB.CH1DATA, 12);
+			ps += (uint64_t)(TCC0.PER + 1) * prescaler[TCC0.CTRLA & 0x07] * 1000000000000ULL / F_CPU;
+		}
+	}
+	fprintf(f, "#%llu\n", (unsigned long long)ps);
+	fclose(f);
+	printf("trace: %s\n", file);
+}
+
+/* Fast boot on the RC, the switch to the crystal PLL and the fall back
+ * when the crystal fails, the model's oscillators are ready when their
+ * STATUS bit is set. */
+static void Clock(void)
+{
+	OSC.CTRL = OSC_RC2MEN_bm;
+	OSC.STATUS = OSC_RC2MRDY_bm | OSC_RC32MRDY_bm | OSC_RC32KRDY_bm;
+	CLK.CTRL = CLK_SCLKSEL_RC2M_gc;
+
+	clock_init();
+	CHECK((CLK.CTRL & CLK_SCLKSEL_gm) == CLK_SCLKSEL_RC32M_gc, "not running from the RC32M after clock_init");
+	CHECK(OSC.CTRL & OSC_XOSCEN_bm, "crystal not started");
+	CHECK(clock_source() == CLOCK_RC32M, "clock_source %u", clock_source());
+	CHECK(!clock_poll(), "switched without a crystal");
+	CHECK(DFLLRC32M.CTRL & DFLL_ENABLE_bm, "RC32M not calibrated");
+
+	OSC.STATUS |= OSC_XOSCRDY_bm;
+	CHECK(!clock_poll(), "switched without a PLL lock");
+	CHECK(OSC.CTRL & OSC_PLLEN_bm, "PLL not started with the crystal ready");
+	CHECK((CLK.CTRL & CLK_SCLKSEL_gm) == CLK_SCLKSEL_RC32M_gc, "left the RC32M before the PLL lock");
+
+	OSC.STATUS |= OSC_PLLRDY_bm;
+	CHECK(clock_poll(), "no switch with the PLL locked");
+	CHECK((CLK.CTRL & CLK_SCLKSEL_gm) == CLK_SCLKSEL_PLL_gc, "not running from the PLL");
+	CHECK(!(OSC.CTRL & (OSC_RC2MEN_bm | OSC_RC32MEN_bm)), "RC oscillators still on");
+	CHECK(clock_source() == CLOCK_PLL, "clock_source %u", clock_source());
+	CHECK(!clock_poll(), "switched twice");
+	CHECK(OSC.XOSCFAIL & OSC_XOSCFDEN_bm, "no crystal failure detection");
+
+	/* the hardware falls back to the 2 MHz RC and raises the NMI */
+	CLK.CTRL = CLK_SCLKSEL_RC2M_gc;
+	OSC.XOSCFAIL |= OSC_XOSCFDIF_bm;
+	OSC_OSCF_vect();
+	CHECK((CLK.CTRL & CLK_SCLKSEL_gm) == CLK_SCLKSEL_RC32M_gc, "not on the RC32M after a crystal failure");
+	CHECK(!(OSC.CTRL & (OSC_PLLEN_bm | OSC_XOSCEN_bm)), "crystal or PLL still on after the failure");
+	CHECK(clock_poll(), "crystal failure not reported");
+	CHECK(clock_source() == CLOCK_RC32M, "clock_source %u", clock_source());
+	CHECK(DFLLRC32M.CTRL & DFLL_ENABLE_bm, "RC32M not calibrated after the failure");
+	CHECK(!clock_poll(), "crystal failure reported twice");
+}
+
+int main(int argc, char **argv)
+{
+	Clock();
+	Ring();
+	TxDma();
+	Telemetry();
+	BaudRates();
+	Cordic();
+	Tables();
+	Commutation();
+	Lock();
+	Nco();
+	Pps();
+	if (argc > 1)
+		Trace(argv[1]);
+
+	printf("%u checks failed\n", failures);
+	return failures ? 1 : 0;
+}
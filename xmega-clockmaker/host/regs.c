@@ -0,0 +1,26 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+/* Peripheral instances of the register model, see host/avr/io.h. */
+
+#include <avr/io.h>
+
+PORT_t PORTA, PORTB, PORTC, PORTD, PORTE, PORTF;
+TC0_t TCC0, TCD0, TCE0, TCF0;
+TC1_t TCC1, TCD1, TCE1;
+AWEX_t AWEXC;
+DAC_t DACB;
+DMA_t DMA;
+EVSYS_t EVSYS;
+ADC_t ADCA;
+USART_t USARTC0, USARTC1, USARTD0, USARTD1, USARTE0, USARTF0;
+OSC_t OSC;
+CLK_t CLK;
+DFLL_t DFLLRC32M, DFLLRC2M;
+PMIC_t PMIC;
+volatile uint8_t SREG, CCP;
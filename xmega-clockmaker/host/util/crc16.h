@@ -0,0 +1,23 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+#ifndef HOST_UTIL_CRC16_H
+#define HOST_UTIL_CRC16_H
+
+#include <stdint.h>
+
+/* CRC-16/XMODEM step, same as the avr-libc one. */
+static inline uint16_t _crc_xmodem_update(uint16_t crc, uint8_t data)
+{
+	crc ^= (uint16_t)data << 8;
+	for (uint8_t i = 0; i < 8; i++)
+		crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+	return crc;
+}
+
+#endif
@@ -0,0 +1,17 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+/* Delays for the host build: none, the bench does not wait for hardware. */
+
+#ifndef HOST_UTIL_DELAY_H
+#define HOST_UTIL_DELAY_H
+
+#define _delay_ms(ms) ((void)(ms))
+#define _delay_us(us) ((void)(us))
+
+#endif
@@ -0,0 +1,137 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <string.h>
+
+#include "avr_compiler.h"
+#include "jitter.h"
+#include "load.h"
+
+#if JITTER
+
+static uint32_t histogram[JITTER_BINS];
+static uint32_t count;
+static uint64_t sum;
+static uint16_t min;
+static uint16_t max;
+
+/*! \brief Start measuring the antenna switch latency.
+ *
+ *  TCE1 counts CPU cycles and captures the ideal switch time, the TCC0
+ *  overflow on event channel 4, into CCA and the actual edge of JITTER_PIN on
+ *  PORTD (event channel 5, both edges) into CCB. Every step adds CCB - CCA
+ *  to the histogram. The capture interrupt comes after TCC0_OVF_vect at the
+ *  same level, so it does not delay the switch it measures.
+ *
+ *  Call after commutation_init(). Needs a mode that drives PORTD, not
+ *  COMMUTATION_MODE_AWEX.
+ */
+void jitter_init(void)
+{
+	register8_t *pinctrl = &PORTD.PIN0CTRL + JITTER_PIN;
+
+	jitter_reset();
+
+	TCE1.CTRLA = TC_CLKSEL_OFF_gc;
+	*pinctrl = (*pinctrl & ~PORT_ISC_gm) | PORT_ISC_BOTHEDGES_gc;
+	EVSYS.CH4MUX = EVSYS_CHMUX_TCC0_OVF_gc;
+	EVSYS.CH5MUX = EVSYS_CHMUX_PORTD_PIN0_gc + JITTER_PIN;
+
+	TCE1.CTRLB = TC1_CCAEN_bm | TC1_CCBEN_bm | TC_WGMODE_NORMAL_gc;
+	TCE1.CTRLD = TC_EVACT_CAPT_gc | TC_EVSEL_CH4_gc;
+	TCE1.PER = 0xFFFF;
+	TCE1.INTCTRLB = TC_CCBINTLVL_LO_gc;
+	TCE1.CTRLA = TC_CLKSEL_DIV1_gc;
+}
+
+/*! \brief Clear the histogram. */
+void jitter_reset(void)
+{
+	AVR_ENTER_CRITICAL_REGION();
+	memset(histogram, 0, sizeof(histogram));
+	count = 0;
+	sum = 0;
+	min = 0xFFFF;
+	max = 0;
+	AVR_LEAVE_CRITICAL_REGION();
+}
+
+/*! \brief Summary of the histogram since jitter_init() or jitter_reset().
+ *
+ *  \param  stats  result
+ *
+ *  \retval true   \em stats is valid
+ *  \retval false  nothing measured yet
+ */
+bool jitter_stats(jitter_stats_t *stats)
+{
+	uint32_t below = 0;
+	uint32_t limit;
+	uint8_t bin;
+
+	AVR_ENTER_CRITICAL_REGION();
+	stats->count = count;
+	stats->min = min;
+	stats->max = max;
+	stats->mean = count ? sum / count : 0;
+	AVR_LEAVE_CRITICAL_REGION();
+
+	if (stats->count == 0)
+		return false;
+
+	/* the bins keep counting meanwhile, close enough for a percentile */
+	limit = stats->count - stats->count / 100;
+	for (bin = 0; bin < JITTER_BINS - 1; ++bin)
+	{
+		AVR_ENTER_CRITICAL_REGION();
+		below += histogram[bin];
+		AVR_LEAVE_CRITICAL_REGION();
+		if (below >= limit)
+			break;
+	}
+	stats->p99 = bin < JITTER_BINS - 1 ? (bin + 1) * JITTER_BIN_CYCLES - 1 : stats->max;
+	return true;
+}
+
+ISR(TCE1_CCB_vect)
+{
+	uint16_t ideal;
+	uint16_t latency;
+	uint8_t bin;
+	LOAD_ENTER();
+
+	/* an edge without an overflow before it has nothing to be measured
+	 * against: the first one, or PORTD set up by commutation_init(). The
+	 * read empties the CCB buffer. */
+	if (count == UINT32_MAX || !(TCE1.INTFLAGS & TC1_CCAIF_bm))
+	{
+		latency = TCE1.CCB;
+		LOAD_LEAVE(LOAD_JITTER);
+		return;
+	}
+
+	/* normally one capture, the latest is the overflow before this edge */
+	do
+		ideal = TCE1.CCA;
+	while (TCE1.INTFLAGS & TC1_CCAIF_bm);
+	latency = TCE1.CCB - ideal;
+
+	bin = latency / JITTER_BIN_CYCLES < JITTER_BINS ? latency / JITTER_BIN_CYCLES : JITTER_BINS - 1;
+	histogram[bin]++;
+	count++;
+	sum += latency;
+	if (latency < min)
+		min = latency;
+	if (latency > max)
+		max = latency;
+	LOAD_LEAVE(LOAD_JITTER);
+}
+
+#endif
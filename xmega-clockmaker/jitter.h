@@ -0,0 +1,49 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+#ifndef JITTER_H
+#define JITTER_H
+
+#include "avr_compiler.h"
+
+/*! \brief Measure the antenna switch latency, uses TCE1 and event channels
+ *         4 and 5. Off by default, it adds an interrupt per step.
+ */
+#ifndef JITTER
+#define JITTER 0
+#endif
+
+/*! \brief PORTD pin measured, it has to change on every step (bit 0 of the
+ *         antenna number with the default ANTENNA_PORT_PATTERN).
+ */
+#ifndef JITTER_PIN
+#define JITTER_PIN 0
+#endif
+
+/*! \brief Histogram bins, the last one also counts everything above it. */
+#define JITTER_BINS 64
+
+/*! \brief Width of a histogram bin in CPU cycles. */
+#define JITTER_BIN_CYCLES 4
+
+/*! \brief Latency from the TCC0 overflow to the edge on PORTD, in CPU cycles. */
+typedef struct jitter_stats {
+	/* \brief Steps measured. */
+	uint32_t count;
+	uint16_t min;
+	uint16_t max;
+	uint16_t mean;
+	/* \brief 99% of the steps are at most this late (upper edge of the bin). */
+	uint16_t p99;
+} jitter_stats_t;
+
+void jitter_init(void);
+void jitter_reset(void);
+bool jitter_stats(jitter_stats_t *stats);
+
+#endif
@@ -0,0 +1,98 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+#include <avr/io.h>
+#include <string.h>
+
+#include "avr_compiler.h"
+#include "timebase.h"
+#include "load.h"
+
+#if LOAD
+
+static load_report_t counters;
+/* All interrupt cycles, to take them out of the idle passes. */
+static uint32_t isr_cycles;
+static uint32_t window_start;
+static uint32_t pass_start;
+static uint32_t pass_isr_cycles;
+
+/*! \brief Low half of the timebase counter, for LOAD_ENTER(). */
+uint16_t load_now(void)
+{
+	uint16_t now;
+
+	/* the TEMP register of TCC1 is shared with nested interrupts */
+	AVR_ENTER_CRITICAL_REGION();
+	now = TCC1.CNT;
+	AVR_LEAVE_CRITICAL_REGION();
+	return now;
+}
+
+/*! \brief Count one interrupt that started at \em start, for LOAD_LEAVE().
+ *
+ *  An interrupt of a higher level nesting in it is counted in both.
+ */
+void load_add(load_isr_t isr, uint16_t start)
+{
+	AVR_ENTER_CRITICAL_REGION();
+	uint16_t cycles = TCC1.CNT - start;
+
+	counters.entries[isr]++;
+	counters.cycles[isr] += cycles;
+	isr_cycles += cycles;
+	AVR_LEAVE_CRITICAL_REGION();
+}
+
+/*! \brief Call once per main loop pass.
+ *
+ *  \param  busy  the pass did some work, otherwise its cycles without the
+ *                interrupts in it count as idle
+ */
+void load_pass(bool busy)
+{
+	uint32_t now = timebase_now();
+	uint32_t isr;
+
+	AVR_ENTER_CRITICAL_REGION();
+	isr = isr_cycles;
+	AVR_LEAVE_CRITICAL_REGION();
+
+	if (!busy)
+		counters.idle += (now - pass_start) - (isr - pass_isr_cycles);
+	pass_start = now;
+	pass_isr_cycles = isr;
+}
+
+/*! \brief Get the counters and start a new window, call from the main loop.
+ *
+ *  \param  report  result
+ */
+void load_report(load_report_t *report)
+{
+	uint32_t now = timebase_now();
+
+	AVR_ENTER_CRITICAL_REGION();
+	*report = counters;
+	memset(&counters, 0, sizeof(counters));
+	AVR_LEAVE_CRITICAL_REGION();
+	report->window = now - window_start;
+	window_start = now;
+}
+
+/*! \brief Short name of an interrupt for the report. */
+const char *load_name(load_isr_t isr)
+{
+	static const char *const names[LOAD_ISR_COUNT] = {
+		"uart rx", "uart tx", "commutation", "bearing", "timebase", "jitter", "pps"
+	};
+
+	return names[isr];
+}
+
+#endif
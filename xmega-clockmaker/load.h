@@ -0,0 +1,67 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+#ifndef LOAD_H
+#define LOAD_H
+
+#include "avr_compiler.h"
+#include "timebase.h"
+
+/*! \brief Count the cycles spent in the interrupts and idle in the main loop.
+ *         Off by default, it costs about 60 cycles per interrupt.
+ */
+#ifndef LOAD
+#define LOAD 0
+#endif
+
+#if LOAD && !TIMEBASE
+#error LOAD counts with the TIMEBASE cycle counter
+#endif
+
+/*! \brief Interrupts counted, the UART ones summed over all UARTs. */
+typedef enum load_isr {
+	LOAD_UART_RX,
+	LOAD_UART_TX,
+	LOAD_COMMUTATION,
+	LOAD_BEARING,
+	LOAD_TIMEBASE,
+	LOAD_JITTER,
+	LOAD_PPS,
+	LOAD_ISR_COUNT
+} load_isr_t;
+
+/*! \brief Counters since the previous load_report(). */
+typedef struct load_report {
+	/* \brief CPU cycles covered, at most 2^32 (134 s at 32 MHz). */
+	uint32_t window;
+	/* \brief Cycles in main loop passes that found nothing to do. */
+	uint32_t idle;
+	uint32_t entries[LOAD_ISR_COUNT];
+	uint32_t cycles[LOAD_ISR_COUNT];
+} load_report_t;
+
+/*! \brief Put LOAD_ENTER() first and LOAD_LEAVE(isr) last in an interrupt,
+ *         LOAD_PASS(busy) at the end of the main loop.
+ */
+#if LOAD
+#define LOAD_ENTER() uint16_t load_start = load_now()
+#define LOAD_LEAVE(isr) load_add((isr), load_start)
+#define LOAD_PASS(busy) load_pass(busy)
+#else
+#define LOAD_ENTER()
+#define LOAD_LEAVE(isr)
+#define LOAD_PASS(busy) ((void)(busy))
+#endif
+
+uint16_t load_now(void);
+void load_add(load_isr_t isr, uint16_t start);
+void load_pass(bool busy);
+void load_report(load_report_t *report);
+const char *load_name(load_isr_t isr);
+
+#endif
@@ -0,0 +1,98 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+#include "avr_compiler.h"
+#include "telemetry.h"
+#include "log.h"
+
+#define LOG_MASK (LOG_BUFFER_SIZE - 1)
+
+/* Records: length of the rest, format address (2 bytes), arguments. */
+static uint8_t buffer[LOG_BUFFER_SIZE];
+static volatile uint8_t head;
+static volatile uint8_t tail;
+static volatile uint16_t dropped;
+
+/*! \brief Store one log record, use the LOG() macro.
+ *
+ *  \param  fmt   format string in flash
+ *  \param  args  raw arguments
+ *  \param  len   size of \em args
+ */
+void log_write(const char *fmt, const void *args, uint8_t len)
+{
+	const uint8_t *p = args;
+	uint16_t id = (uint16_t)fmt;
+	uint8_t h;
+
+	AVR_ENTER_CRITICAL_REGION();
+	h = head;
+	if (((tail - h - 1) & LOG_MASK) < len + 3)
+	{
+		dropped++;
+	}
+	else
+	{
+		buffer[h] = len + 2;
+		h = (h + 1) & LOG_MASK;
+		buffer[h] = id;
+		h = (h + 1) & LOG_MASK;
+		buffer[h] = id >> 8;
+		h = (h + 1) & LOG_MASK;
+		while (len--)
+		{
+			buffer[h] = *p++;
+			h = (h + 1) & LOG_MASK;
+		}
+		head = h;
+	}
+	AVR_LEAVE_CRITICAL_REGION();
+}
+
+/*! \brief Send the stored records as TELEMETRY_LOG frames, call from the
+ *         main loop.
+ *
+ *  \param  send  false discards the records (text output, no frames)
+ *
+ *  \retval true   records were sent or discarded
+ *  \retval false  none waiting
+ */
+bool log_flush(bool send)
+{
+	uint8_t t = tail;
+
+	if (t == head)
+		return false;
+	while (t != head)
+	{
+		uint8_t len = buffer[t];
+
+		t = (t + 1) & LOG_MASK;
+		if (send)
+		{
+			telemetry_begin(TELEMETRY_LOG);
+			for (uint8_t i = 0; i < len; ++i)
+				telemetry_put(&buffer[(t + i) & LOG_MASK], 1);
+			telemetry_end();
+		}
+		t = (t + len) & LOG_MASK;
+		tail = t;
+	}
+	return true;
+}
+
+/*! \brief Number of records dropped because the log buffer was full. */
+uint16_t log_dropped(void)
+{
+	uint16_t n;
+
+	AVR_ENTER_CRITICAL_REGION();
+	n = dropped;
+	AVR_LEAVE_CRITICAL_REGION();
+	return n;
+}
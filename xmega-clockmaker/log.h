@@ -0,0 +1,57 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+#ifndef LOG_H
+#define LOG_H
+
+#include "avr_compiler.h"
+
+/*! \brief Bytes of log records held until log_flush(), a power of two. */
+#ifndef LOG_BUFFER_SIZE
+#define LOG_BUFFER_SIZE 64
+#endif
+
+#if (LOG_BUFFER_SIZE & (LOG_BUFFER_SIZE - 1)) || LOG_BUFFER_SIZE > 256
+#error LOG_BUFFER_SIZE is not a power of two up to 256
+#endif
+
+/*! \brief Log a message without formatting it on the device.
+ *
+ *  Stores the flash address of \em fmt and the raw arguments, the host
+ *  decoder (tools/telemetry_decode.c -e) looks the format up in the ELF file
+ *  and prints it. Up to 4 arguments, integers and floats (promoted like
+ *  printf arguments: %d %u %x %c are 2 bytes, %ld %lu %lx 4, %f 4), no %s.
+ *  Costs a few dozen cycles and is safe in interrupts.
+ *
+ *  \code
+ *  LOG("bearing: %u rotations lost", overruns);
+ *  \endcode
+ */
+#define LOG(fmt, ...)                                                          \
+	do {                                                                       \
+		static const char log_fmt[] PROGMEM = fmt;                             \
+		struct { LOG_FIELDS(__VA_ARGS__) } log_args = { __VA_ARGS__ };         \
+		log_write(log_fmt, &log_args, sizeof(log_args));                       \
+	} while (0)
+
+#define LOG_CAT(a, b) LOG_CAT_(a, b)
+#define LOG_CAT_(a, b) a ## b
+#define LOG_NARGS(...) LOG_NARGS_(0, ##__VA_ARGS__, 4, 3, 2, 1, 0)
+#define LOG_NARGS_(_0, _1, _2, _3, _4, n, ...) n
+#define LOG_FIELDS(...) LOG_CAT(LOG_FIELDS_, LOG_NARGS(__VA_ARGS__))(__VA_ARGS__)
+#define LOG_FIELDS_0()
+#define LOG_FIELDS_1(a) __typeof__((a) + 0) a0;
+#define LOG_FIELDS_2(a, b) LOG_FIELDS_1(a) __typeof__((b) + 0) a1;
+#define LOG_FIELDS_3(a, b, c) LOG_FIELDS_2(a, b) __typeof__((c) + 0) a2;
+#define LOG_FIELDS_4(a, b, c, d) LOG_FIELDS_3(a, b, c) __typeof__((d) + 0) a3;
+
+void log_write(const char *fmt, const void *args, uint8_t len);
+bool log_flush(bool send);
+uint16_t log_dropped(void);
+
+#endif
@@ -7,22 +7,59 @@
 // Written By Floris Romeijn //
 
 
-#define F_CPU 32000000UL
-
 #include <avr/io.h>
 #include <util/delay.h>
 #include <avr/interrupt.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "avr_compiler.h"
-#include "clksys_driver.h"
 #define ENABLE_UART_F0    	1
+/* command input is short lines, telemetry needs the large transmit buffer */
+#define UART_F0_RX_SIZE		64
+#define UART_F0_TX_SIZE		256
+/* DMA channel for transmitting on UART F0 (see uart_tx_dma), undefine for the
+ * DRE interrupt. Only some builds have a channel to spare: CH1 with
+ * COMMUTATION_MODE_ISR or COMMUTATION_MODE_NCO, CH2 or CH3 with BEARING 0.
+ * The default build (COMMUTATION_MODE_DMA and the bearing estimate) has none. */
+//#define UART_TX_DMA_F0		1
 #include "uart.h"
 #include "usart_driver.h"
+#include "commutation.h"
+#include "bearing.h"
+#include "telemetry.h"
+#include "shell.h"
+#include "log.h"
+#include "timebase.h"
+#include "jitter.h"
+#include "load.h"
+#include "clock.h"
+#include "pps.h"
 
 #define PROTO 
 
+/* COMMUTATION_MODE_ISR, _DMA, _NCO, _AWEX (4 antennas on PC0/2/4/6) or
+ * _CROSSFADE (build with COMMUTATION_CROSSFADE=1) */
+#define COMMUTATION_MODE COMMUTATION_MODE_DMA
+/* antennas in the array: 4, 8 or 16 (see antennas.c) */
+#define ANTENNAS 4
+/* rotation frequency at power up in mHz, 5kHz steps with 4 antennas */
+#define ROTATION_MHZ 1250000UL
+/* baud rate at power up, the shell command 'baud' changes it; the USART
+ * settings are worked out at compile time, see uart_baud.h */
+#define BAUD 230400UL
+#include "uart_baud.h"
+/* output at power up: 0 text, 1 telemetry frames (bearings, counters),
+ * 2 also a frame per rotation (a timestamp with TIMEBASE); decode with
+ * tools/telemetry_decode.c */
+#define TELEMETRY_LEVEL 0
+
+#ifdef UART_TX_DMA_F0
+_Static_assert(!((1 << UART_TX_DMA_F0) & (COMMUTATION_DMA_CHANNELS(COMMUTATION_MODE) | (BEARING ? BEARING_DMA_CHANNELS : 0))),
+               "UART_TX_DMA_F0 uses a DMA channel of the commutation or the bearing estimate");
+#endif
+
 #ifdef PROTO
 
 #define LED_ROOD_ON PORTF.OUTSET = PIN0_bm
@@ -35,31 +72,48 @@
 
 #else
 
+/* the blue LED sits on PC0, which TCC0 owns as the debug pulse (OC0A) or
+ * AWEX antenna 0 in every commutation mode but NCO: it stays dark */
 #define LED_ROOD_ON PORTF.OUTSET = PIN1_bm
 #define LED_GROEN_ON PORTF.OUTSET = PIN0_bm
-#define LED_BLAUW_ON PORTC.OUTSET = PIN0_bm
+#define LED_BLAUW_ON ((void)0)
 
 #define LED_ROOD_OFF PORTF.OUTCLR = PIN1_bm
 #define LED_GROEN_OFF PORTF.OUTCLR = PIN0_bm
-#define LED_BLAUW_OFF PORTC.OUTCLR = PIN0_bm
+#define LED_BLAUW_OFF ((void)0)
 
 #endif
 
-static void Init32MhzFrom16MhzExternal(void);
 static void EnableAllInterupts(void);
-static void InitClockAndDac(void);
+static void Print(const char *s);
+static bool SendCounters(void);
 
-char str[256];
+char str[64];
+/* current settings, changed by the shell */
+static shell_settings_t settings = {
+	COMMUTATION_MODE, ROTATION_MHZ, ANTENNAS, true, BAUD, TELEMETRY_LEVEL
+};
 
 int main(void)
 {
-	PORTC.DIRSET = PIN0_bm;
+	commutation_plan_t plan;
+	bearing_t bearing;
+#if TIMEBASE
+	timebase_stamp_t stamp;
+#else
+	uint8_t rotation = 0;
+#endif
+
 	PORTF.DIRSET = PIN0_bm | PIN1_bm;
 
-	Init32MhzFrom16MhzExternal();
+	clock_init();
 
 	EnableAllInterupts();
 
+#if CLOCK_FAST_BOOT
+	/* on until the crystal takes over */
+	LED_BLAUW_ON;
+#else
 	for (int i = 0; i < 10; ++i)
 	{
 		LED_BLAUW_ON;
@@ -67,77 +121,156 @@ int main(void)
 		LED_BLAUW_OFF;
 		_delay_ms(20);
 	}
+#endif
 
-	init_uart(&uartF0, &USARTF0, F_CPU, 230400, 0);
-	sprintf(str, "\n\r\n\rxmega-clockmaker\n\rlast build: __DATE__ __TIME__ \n\r");
-  	uart_puts(&uartF0, str);
+	init_uart(&uartF0, &USARTF0, BAUD_SETTING);
+#ifdef UART_TX_DMA_F0
+	uart_tx_dma(&uartF0, UART_TX_DMA_F0);
+#endif
+	telemetry_init(&uartF0);
+	Print("\n\r\n\rxmega-clockmaker\n\rlast build: " __DATE__ " " __TIME__ "\n\r");
+
+	if (commutation_plan(COMMUTATION_MODE, F_CPU, ROTATION_MHZ, ANTENNAS, &plan))
+	{
+		commutation_init(COMMUTATION_MODE, &plan);
+		sprintf(str, "rotation: %lu mHz (%ld ppm)\n\r", plan.achieved_mhz, plan.error_ppm);
+	}
+	else
+	{
+		sprintf(str, "rotation: %lu mHz not possible\n\r", ROTATION_MHZ);
+	}
+	Print(str);
+
+	shell_init(&uartF0, &settings, Print);
+
+#if TIMEBASE
+	timebase_init();
+#endif
+#if PPS
+	pps_init();
+#endif
+#if JITTER
+	jitter_init();
+#endif
 
-  	InitClockAndDac();
+#if BEARING
+	if (!bearing_init())
+	{
+		Print("bearing: not possible in this mode\n\r");
+	}
+#endif
 
 	while(1)
 	{
-		//yolo
+		bool busy = shell_poll();
+
+		if (clock_poll())
+		{
+			busy = true;
+			if (clock_source() == CLOCK_PLL)
+			{
+				LED_BLAUW_OFF;
+				Print("clock: crystal PLL\n\r");
+			}
+			else
+			{
+				LED_BLAUW_ON;
+				Print("clock: crystal failed, internal RC\n\r");
+			}
+		}
+
+#if BEARING
+		if (bearing_poll(&bearing))
+		{
+			busy = true;
+			if (settings.telemetry_level > 0)
+			{
+				telemetry_begin(TELEMETRY_BEARING);
+				telemetry_put(&bearing.angle, sizeof(bearing.angle));
+				telemetry_put(&bearing.quality, 1);
+				telemetry_put(&bearing.overruns, 1);
+				telemetry_end();
+			}
+			else
+			{
+				uint16_t deg10 = ((uint32_t)bearing.angle * 3600 + 32768) >> 16;
+
+				sprintf(str, "bearing: %u.%u deg q=%u%%\n\r", deg10 / 10, deg10 % 10, bearing.quality);
+				Print(str);
+			}
+		}
+#endif
+#if TIMEBASE
+		if (timebase_poll(&stamp))
+		{
+			busy = true;
+#if PPS
+			pps_rotation(&stamp);
+#endif
+			if (settings.telemetry_level > 1)
+			{
+				telemetry_begin(TELEMETRY_TIMESTAMP);
+				telemetry_put(&stamp.rotation, 1);
+				telemetry_put(&stamp.cycles, sizeof(stamp.cycles));
+				telemetry_put(&stamp.lost, 1);
+				telemetry_end();
+			}
+		}
+#if PPS
+		if (pps_poll(settings.rotation_mhz))
+			busy = true;
+#endif
+#else
+		if (settings.telemetry_level > 1 && commutation_rotation() != rotation)
+		{
+			busy = true;
+			rotation = commutation_rotation();
+			telemetry_send(TELEMETRY_ROTATION, &rotation, 1);
+		}
+#endif
+		if (log_flush(settings.telemetry_level > 0))
+			busy = true;
+		if (settings.telemetry_level > 0 && SendCounters())
+			busy = true;
+		LOAD_PASS(busy);
 	}
 }
 
-ISR(TCC0_OVF_vect)
+/* Text output: as is at telemetry level 0, else in a TELEMETRY_TEXT frame
+ * without the line breaks. */
+static void Print(const char *s)
 {
-	static uint8_t counter;
-	counter++;
-	if(counter > 3)
-		counter = 0;
-	PORTD.OUT = 0b11 & counter;
-	//debug leds
-	PORTF.OUT = 0b11 & counter;
-
-	//ahead for next event
-	uint16_t todac = counter + 1;
-	if(todac > 3)
-		todac = 0;
-
-	DACB.CH0DATA = todac<<10;
-	//DACB.CH0DATA = 0xfff;
-	_delay_ms(1);
-	PORTF.OUT = 0;
-}
+	uint8_t len;
 
+	if (settings.telemetry_level == 0)
+	{
+		uart_puts(&uartF0, (char *)s);
+		return;
+	}
 
-static void InitClockAndDac(void)
-{
-	PORTD.OUTCLR = PIN0_bm|PIN1_bm;
-	PORTD.DIRSET = PIN0_bm|PIN1_bm;
-
-	//TCC0.CTRLA = TC_CLKSEL_DIV256_gc;
-	TCC0.CTRLA = TC_CLKSEL_DIV1024_gc;
-	TCC0.CTRLB = TC_WGMODE_NORMAL_gc;
-	TCC0.CTRLD = TC_EVACT_OFF_gc | TC_EVSEL_OFF_gc;
-	TCC0.INTCTRLA = TC_OVFINTLVL_LO_gc;
-	EVSYS.CH0MUX = EVSYS_CHMUX_TCC0_OVF_gc;
-	//TCC0.PER = 24; //5kHz;
-	TCC0.PER = 500000;
-
-	PORTB.PIN2CTRL = PORT_ISC_INPUT_DISABLE_gc; /* DAC output; turn off input buffer (may or may not do much good) */
-
-	DACB.CTRLA = DAC_CH0EN_bm | DAC_ENABLE_bm;
-	DACB.CTRLB = DAC_CHSEL_SINGLE_gc | DAC_CH0TRIG_bm;
-	DACB.CTRLC = DAC_REFSEL_AVCC_gc;
-	DACB.EVCTRL = DAC_EVSEL_0_gc;
+	while (*s == '\n' || *s == '\r')
+		s++;
+	len = strlen(s);
+	while (len > 0 && (s[len - 1] == '\n' || s[len - 1] == '\r'))
+		len--;
+	telemetry_send(TELEMETRY_TEXT, s, len);
 }
 
-
-static void Init32MhzFrom16MhzExternal(void)
+/* TELEMETRY_COUNTERS frame whenever a drop counter changed, true when one
+ * did (the frame may still have been dropped). */
+static bool SendCounters(void)
 {
-	CLKSYS_XOSC_Config( OSC_FRQRANGE_12TO16_gc, 0, OSC_XOSCSEL_XTAL_16KCLK_gc );
-	CLKSYS_Enable( OSC_XOSCEN_bm );
-	do {} while ( CLKSYS_IsReady( OSC_XOSCRDY_bm ) == 0 );
-
-	CLKSYS_PLL_Config( OSC_PLLSRC_XOSC_gc, 2);
-	CLKSYS_Enable( OSC_PLLEN_bm );
-	do {} while ( CLKSYS_IsReady( OSC_PLLRDY_bm ) == 0 );
-
-	CLKSYS_Main_ClockSource_Select( CLK_SCLKSEL_PLL_gc );
-	CLKSYS_Disable( OSC_RC2MEN_bm );
-	CLKSYS_Disable( OSC_RC32MEN_bm );
+	static uint16_t sent[4];
+	uint16_t now[4];
+
+	uart_dropped(&uartF0, &now[0], &now[1]);
+	now[2] = telemetry_dropped();
+	now[3] = log_dropped();
+	if (memcmp(now, sent, sizeof(now)) == 0)
+		return false;
+	if (telemetry_send(TELEMETRY_COUNTERS, now, sizeof(now)))
+		memcpy(sent, now, sizeof(now));
+	return true;
 }
 
 static void EnableAllInterupts(void)
@@ -0,0 +1,267 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "avr_compiler.h"
+#include "commutation.h"
+#include "pps.h"
+#include "log.h"
+#include "load.h"
+
+#if PPS
+
+/* CPU cycles between reference edges at the nominal F_CPU, signed so the
+ * 64 bit error terms stay signed where unsigned long is 64 bit too. */
+#define PPS_CYCLES ((int32_t)(F_CPU / PPS_HZ))
+
+/* Last captured edge, edge_count counts the captures. */
+static volatile uint32_t edge_time;
+static volatile uint8_t edge_count;
+static uint8_t edge_seen;
+static uint32_t last_edge;
+static bool have_edge;
+
+/* Last rotation start and the length of a rotation in CPU cycles. */
+static uint32_t rotation_time;
+static uint8_t rotation_number;
+static uint32_t rotation_cycles;
+static bool have_rotation;
+
+/* Place of the rotation start at the next edge, 2^32 is a rotation. It
+ * moves by target_inc per edge when the rotations do not fit the edges. */
+static uint32_t planned_mhz;
+static uint32_t target;
+static uint32_t target_inc;
+
+/* Loop state, in 1/65536 CPU cycles per rotation. */
+static int32_t integral;
+static int32_t trim;
+static int32_t limit;
+
+static pps_state_t state;
+static int32_t phase_error;
+static int32_t clock_ppb;
+static uint32_t edges;
+static uint8_t in_lock;
+
+static int32_t Clamp(int32_t value)
+{
+	if (value > limit)
+		return limit;
+	if (value < -limit)
+		return -limit;
+	return value;
+}
+
+/* Start over for a rotation frequency, the trim of the old one is meaningless. */
+static void Restart(uint32_t rotation_mhz)
+{
+	planned_mhz = rotation_mhz;
+	target = 0;
+	target_inc = ((uint64_t)rotation_mhz << 32) / (1000UL * PPS_HZ);
+	integral = 0;
+	trim = 0;
+	limit = 0;
+	in_lock = 0;
+	have_rotation = false;
+	rotation_cycles = 0;
+	if (state == PPS_LOCKED)
+		state = PPS_ACQUIRING;
+	commutation_trim(0);
+}
+
+/* Rotation start minus target at edge t in CPU cycles, within half a rotation. */
+static int32_t PhaseError(uint32_t t)
+{
+	int32_t since = (int32_t)(t - rotation_time) % (int32_t)rotation_cycles;
+	int32_t error;
+
+	if (since < 0)
+		since += rotation_cycles;
+	error = (int32_t)(((uint64_t)target * rotation_cycles) >> 32) - since;
+	if (error > (int32_t)rotation_cycles / 2)
+		error -= rotation_cycles;
+	else if (error < -(int32_t)rotation_cycles / 2)
+		error += rotation_cycles;
+	return error;
+}
+
+/* One step of the loop: proportional and integral term on the phase error,
+ * scaled to the rotation length change that removes it in one edge. */
+static void Steer(int32_t error)
+{
+	int64_t step = ((((int64_t)error << 32) / PPS_CYCLES) * rotation_cycles) >> 16;
+	int64_t most;
+
+	limit = (int64_t)rotation_cycles * 65536 * PPS_TRIM_MAX_PPM / 1000000;
+	/* the proportional term alone may go to the limit, so may the step for the integral */
+	most = (int64_t)limit * 4 * PPS_TAU * PPS_TAU;
+	if (step > most)
+		step = most;
+	else if (step < -most)
+		step = -most;
+	integral = Clamp(integral - (int32_t)(step / (4 * PPS_TAU * PPS_TAU)));
+	trim = Clamp(integral - (int32_t)(step / PPS_TAU));
+	commutation_trim(trim);
+}
+
+static void Track(int32_t error)
+{
+	if (error <= PPS_LOCK_CYCLES && error >= -PPS_LOCK_CYCLES)
+	{
+		if (in_lock < PPS_LOCK_EDGES)
+			in_lock++;
+	}
+	else
+	{
+		in_lock = 0;
+	}
+
+	if (state != PPS_LOCKED && in_lock == PPS_LOCK_EDGES)
+	{
+		state = PPS_LOCKED;
+		LOG("pps: locked, clock %ld ppb", clock_ppb);
+	}
+	else if (state == PPS_LOCKED && (error > 4 * PPS_LOCK_CYCLES || error < -4 * PPS_LOCK_CYCLES))
+	{
+		state = PPS_ACQUIRING;
+		LOG("pps: lock lost, phase %ld cycles", error);
+	}
+}
+
+/*! \brief Start measuring the reference on PORTE PPS_PIN.
+ *
+ *  Its rising edges go through event channel 1 into CCB of TCC1 and TCD0,
+ *  next to the rotation starts timebase.c captures into CCA: both are
+ *  timestamps on the same 32 bit cycle counter. Call after timebase_init().
+ *  Not available in COMMUTATION_MODE_NCO, which has no rotation starts.
+ */
+void pps_init(void)
+{
+	register8_t *pinctrl = &PORTE.PIN0CTRL + PPS_PIN;
+
+	state = PPS_NO_SIGNAL;
+	edges = 0;
+	edge_seen = edge_count;
+	have_edge = false;
+	phase_error = 0;
+	clock_ppb = 0;
+	Restart(0);
+
+	PORTE.DIRCLR = 1 << PPS_PIN;
+	*pinctrl = (*pinctrl & ~PORT_ISC_gm) | PORT_ISC_RISING_gc;
+	EVSYS.CH1MUX = EVSYS_CHMUX_PORTE_PIN0_gc + PPS_PIN;
+
+	TCC1.CTRLB |= TC1_CCBEN_bm;
+	TCD0.CTRLB |= TC0_CCBEN_bm;
+	TCC1.INTCTRLB = (TCC1.INTCTRLB & ~TC1_CCBINTLVL_gm) | TC_CCBINTLVL_LO_gc;
+}
+
+/*! \brief Hand over a rotation start from timebase_poll(), call for every one. */
+void pps_rotation(const timebase_stamp_t *stamp)
+{
+	uint8_t rotations = stamp->rotation - rotation_number;
+
+	if (have_rotation && rotations != 0)
+		rotation_cycles = (stamp->cycles - rotation_time) / rotations;
+	rotation_time = stamp->cycles;
+	rotation_number = stamp->rotation;
+	have_rotation = true;
+}
+
+/*! \brief Run the loop on a new reference edge, call from the main loop.
+ *
+ *  Measures the CPU clock against the reference and the phase of the last
+ *  rotation start against the edge, and trims the rotation length with
+ *  commutation_trim() to move the rotation starts onto the edges. Without
+ *  edges for 3 periods the last frequency correction is held.
+ *
+ *  \param  rotation_mhz  rotation frequency in use, a change restarts the loop
+ *
+ *  \retval true   an edge was handled or the reference was lost
+ *  \retval false  nothing to do
+ */
+bool pps_poll(uint32_t rotation_mhz)
+{
+	uint8_t count = edge_count;
+	uint8_t passed;
+	uint32_t t;
+	uint32_t interval;
+
+	if (rotation_mhz != planned_mhz)
+		Restart(rotation_mhz);
+
+	if (count == edge_seen)
+	{
+		if (state == PPS_NO_SIGNAL || timebase_now() - last_edge <= 3 * PPS_CYCLES)
+			return false;
+		state = PPS_NO_SIGNAL;
+		in_lock = 0;
+		trim = integral;
+		commutation_trim(trim);
+		LOG("pps: reference lost");
+		return true;
+	}
+
+	AVR_ENTER_CRITICAL_REGION();
+	t = edge_time;
+	count = edge_count;
+	AVR_LEAVE_CRITICAL_REGION();
+	passed = count - edge_seen;
+	edge_seen = count;
+	edges += passed;
+	interval = t - last_edge;
+	last_edge = t;
+	if (state == PPS_NO_SIGNAL)
+		state = PPS_ACQUIRING;
+
+	/* edges in between were missed, their place is still known */
+	target += target_inc * passed;
+	if (!have_edge)
+	{
+		have_edge = true;
+		return true;
+	}
+	if (passed == 1 && interval > PPS_CYCLES - PPS_CYCLES / 1000 && interval < PPS_CYCLES + PPS_CYCLES / 1000)
+		clock_ppb = ((int64_t)interval - PPS_CYCLES) * 1000000000 / PPS_CYCLES;
+	if (rotation_cycles == 0)
+		return true;
+
+	phase_error = PhaseError(t);
+	Steer(phase_error);
+	Track(phase_error);
+	return true;
+}
+
+/*! \brief Lock state, phase and clock error at the last reference edge. */
+void pps_status(pps_status_t *status)
+{
+	status->state = state;
+	status->phase_error = phase_error;
+	status->clock_ppb = clock_ppb;
+	status->trim = trim;
+	status->edges = edges;
+}
+
+/* Takes the reference edge, the loop runs in pps_poll(). One capture per
+ * call: reading CCB clears the flag, a second capture still in the buffer
+ * sets it again and the vector runs once more. */
+ISR(TCC1_CCB_vect)
+{
+	uint16_t lo;
+
+	LOAD_ENTER();
+	lo = TCC1.CCB;
+	edge_time = (uint32_t)TCD0.CCB << 16 | lo;
+	edge_count++;
+	LOAD_LEAVE(LOAD_PPS);
+}
+
+#endif
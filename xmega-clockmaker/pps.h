@@ -0,0 +1,81 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+#ifndef PPS_H
+#define PPS_H
+
+#include "avr_compiler.h"
+#include "timebase.h"
+
+/*! \brief Lock the rotations to an external reference on PORTE, uses event
+ *         channel 1 and the CCB channels of the TIMEBASE counter. Off by
+ *         default, it needs the reference signal.
+ */
+#ifndef PPS
+#define PPS 0
+#endif
+
+/*! \brief PORTE pin of the reference, rising edges count. */
+#ifndef PPS_PIN
+#define PPS_PIN 0
+#endif
+
+/*! \brief Reference edges per second: 1 for 1PPS, 1000 for 10 MHz divided
+ *         by 10000. The rotations start on the edges when the rotation
+ *         frequency is a multiple of this.
+ */
+#ifndef PPS_HZ
+#define PPS_HZ 1
+#endif
+
+/*! \brief Time constant of the loop in reference edges, the integral term
+ *         uses 4 * PPS_TAU^2 for critical damping.
+ */
+#ifndef PPS_TAU
+#define PPS_TAU 4
+#endif
+
+/*! \brief Locked after PPS_LOCK_EDGES edges within this many CPU cycles,
+ *         unlocked again beyond 4 times this.
+ */
+#define PPS_LOCK_CYCLES 64
+#define PPS_LOCK_EDGES 8
+
+/*! \brief Largest change of the rotation length the loop makes, in ppm. */
+#define PPS_TRIM_MAX_PPM 200
+
+#if PPS && !TIMEBASE
+#error PPS timestamps the reference with the TIMEBASE cycle counter
+#endif
+
+/*! \brief State of the reference lock. */
+typedef enum pps_state {
+	PPS_NO_SIGNAL,
+	PPS_ACQUIRING,
+	PPS_LOCKED,
+} pps_state_t;
+
+/*! \brief Lock state and errors at the last reference edge, see pps_status(). */
+typedef struct pps_status {
+	pps_state_t state;
+	/* \brief Rotation start minus its place on the reference, in CPU cycles (negative is early). */
+	int32_t phase_error;
+	/* \brief CPU clock against the reference in ppb, positive is fast. */
+	int32_t clock_ppb;
+	/* \brief Rotation length correction in 1/65536 CPU cycles, see commutation_trim(). */
+	int32_t trim;
+	/* \brief Reference edges since pps_init(). */
+	uint32_t edges;
+} pps_status_t;
+
+void pps_init(void);
+void pps_rotation(const timebase_stamp_t *stamp);
+bool pps_poll(uint32_t rotation_mhz);
+void pps_status(pps_status_t *status);
+
+#endif
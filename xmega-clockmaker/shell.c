@@ -0,0 +1,275 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "avr_compiler.h"
+#include "usart_driver.h"
+#include "uart.h"
+#include "commutation.h"
+#include "jitter.h"
+#include "load.h"
+#include "pps.h"
+#include "shell.h"
+
+static USART_data_t *shell_uart;
+static shell_settings_t *settings;
+static void (*print)(const char *s);
+
+static char line[SHELL_LINE_MAX + 1];
+static uint8_t length;
+static bool too_long;
+/* Baud rate to switch to once the reply is on the line, 0 for none. */
+static uint32_t pending_baud;
+static uart_baud_t pending_setting;
+static char reply[64];
+
+/* Plans and applies a rotation frequency and array size, the switch happens
+ * at the next rotation start. */
+static bool Apply(uint32_t mhz, uint8_t antennas)
+{
+	commutation_plan_t plan;
+
+	if (!commutation_plan(settings->mode, F_CPU, mhz, antennas, &plan))
+		return false;
+
+	commutation_apply(&plan);
+	settings->rotation_mhz = mhz;
+	settings->antennas = antennas;
+	sprintf(reply, "rotation: %lu mHz (%ld ppm), %u antennas\n\r",
+	        plan.achieved_mhz, plan.error_ppm, antennas);
+	print(reply);
+	return true;
+}
+
+static void Status(void)
+{
+	sprintf(reply, "rate %lu antennas %u marker %s\n\r", settings->rotation_mhz,
+	        settings->antennas, settings->frame_codes ? "on" : "off");
+	print(reply);
+	sprintf(reply, "baud %lu telemetry %u\n\r", settings->baud, settings->telemetry_level);
+	print(reply);
+}
+
+#if JITTER
+/* Prints the switch latency histogram summary, or clears it. */
+static void Jitter(bool reset)
+{
+	jitter_stats_t stats;
+
+	if (reset)
+		jitter_reset();
+	else if (!jitter_stats(&stats))
+		print("jitter: no steps measured\n\r");
+	else
+	{
+		sprintf(reply, "jitter: %lu steps, min %u max %u mean %u p99 %u cycles\n\r",
+		        stats.count, stats.min, stats.max, stats.mean, stats.p99);
+		print(reply);
+	}
+}
+#define JITTER_HELP " | jitter [reset]"
+#else
+#define JITTER_HELP ""
+#endif
+
+#if LOAD
+/* Prints the share of the CPU per interrupt and idle since the last call. */
+static void Load(void)
+{
+	load_report_t report;
+	uint16_t permille;
+
+	load_report(&report);
+	if (report.window == 0)
+		return;
+	for (uint8_t i = 0; i < LOAD_ISR_COUNT; ++i)
+	{
+		if (report.entries[i] == 0)
+			continue;
+		permille = (uint64_t)report.cycles[i] * 1000 / report.window;
+		sprintf(reply, "%s: %lu calls %u.%u%%\n\r", load_name(i), report.entries[i],
+		        permille / 10, permille % 10);
+		print(reply);
+	}
+	permille = (uint64_t)report.idle * 1000 / report.window;
+	sprintf(reply, "idle: %u.%u%%\n\r", permille / 10, permille % 10);
+	print(reply);
+}
+#define LOAD_HELP " | load"
+#else
+#define LOAD_HELP ""
+#endif
+
+#if PPS
+/* Prints the reference lock state and the errors at the last edge. */
+static void Pps(void)
+{
+	static const char *const states[] = { "no signal", "acquiring", "locked" };
+	pps_status_t status;
+
+	pps_status(&status);
+	sprintf(reply, "pps: %s, %lu edges\n\r", states[status.state], status.edges);
+	print(reply);
+	sprintf(reply, "phase %ld cycles clock %ld ppb\n\r", status.phase_error, status.clock_ppb);
+	print(reply);
+}
+#define PPS_HELP " | pps"
+#else
+#define PPS_HELP ""
+#endif
+
+/* Runs one command line: a command word and at most one argument. */
+static void Execute(char *cmd)
+{
+	char *arg;
+	char *end;
+	unsigned long value = 0;
+	bool ok = true;
+
+	while (*cmd == ' ')
+		cmd++;
+	if (*cmd == '\0')
+		return;
+
+	arg = strchr(cmd, ' ');
+	if (arg)
+	{
+		*arg++ = '\0';
+		while (*arg == ' ')
+			arg++;
+		value = strtoul(arg, &end, 10);
+		if (end == arg)
+			value = 0;
+	}
+
+	if (strcmp(cmd, "rate") == 0 && value)
+		ok = Apply(value, settings->antennas);
+	else if (strcmp(cmd, "antennas") == 0 && value && value <= 255)
+		ok = Apply(settings->rotation_mhz, value);
+	else if (strcmp(cmd, "marker") == 0 && arg && (strcmp(arg, "on") == 0 || strcmp(arg, "off") == 0))
+	{
+		settings->frame_codes = arg[1] == 'n';
+		commutation_frame_codes(settings->frame_codes);
+	}
+	else if (strcmp(cmd, "baud") == 0 && value >= 2400)
+	{
+		ok = uart_calc_baud(F_CPU, value, &pending_setting);
+		if (ok)
+			pending_baud = value;
+	}
+	else if (strcmp(cmd, "telemetry") == 0 && arg && value <= 2)
+		settings->telemetry_level = value;
+	else if (strcmp(cmd, "status") == 0)
+		Status();
+#if JITTER
+	else if (strcmp(cmd, "jitter") == 0 && (!arg || strcmp(arg, "reset") == 0))
+		Jitter(arg != NULL);
+#endif
+#if LOAD
+	else if (strcmp(cmd, "load") == 0)
+		Load();
+#endif
+#if PPS
+	else if (strcmp(cmd, "pps") == 0)
+		Pps();
+#endif
+	else if (strcmp(cmd, "help") == 0)
+		print("rate <mHz> | antennas <n> | marker on|off | baud <n> | telemetry 0|1|2 | status" JITTER_HELP LOAD_HELP PPS_HELP "\n\r");
+	else
+	{
+		print("error: unknown command or argument\n\r");
+		return;
+	}
+
+	print(ok ? "ok\n\r" : "error: not possible\n\r");
+	if (pending_baud)
+		uart_tx_idle(shell_uart);
+}
+
+/*! \brief Start the command shell on a UART.
+ *
+ *  Commands are lines ending in CR or LF, backspace works:
+ *  - rate <mHz>        rotation frequency
+ *  - antennas <n>      array size (4, 8 or 16)
+ *  - marker on|off     frame codes on DACB CH1
+ *  - baud <n>          baud rate, switched after the reply is sent
+ *  - telemetry 0|1|2   output level, see main.c
+ *  - jitter [reset]    switch latency summary, with JITTER (jitter.h)
+ *  - load              CPU share per interrupt since the last call, with LOAD
+ *  - pps               reference lock, phase and clock error, with PPS (pps.h)
+ *  - status, help
+ *
+ *  Rotation changes go through commutation_apply() and take effect at the
+ *  next rotation start, the frame codes with the next code.
+ *
+ *  \param  uart      initialized UART to read commands from
+ *  \param  s         current settings, updated by the commands
+ *  \param  out       prints a reply, text or telemetry frame
+ */
+void shell_init(USART_data_t *uart, shell_settings_t *s, void (*out)(const char *s))
+{
+	shell_uart = uart;
+	settings = s;
+	print = out;
+	length = 0;
+	too_long = false;
+	pending_baud = 0;
+}
+
+/*! \brief Handle received characters, call from the main loop.
+ *
+ *  Never waits: it handles at most SHELL_BYTES_PER_POLL characters and runs at
+ *  most one command per call. The commutation runs from its interrupts and
+ *  DMA, so a slow command only delays the main loop.
+ *
+ *  \retval true   characters were handled
+ *  \retval false  nothing to do
+ */
+bool shell_poll(void)
+{
+	uint16_t c;
+
+	if (pending_baud && uart_tx_idle(shell_uart))
+	{
+		uart_set_baud(shell_uart, pending_setting);
+		settings->baud = pending_baud;
+		pending_baud = 0;
+	}
+
+	for (uint8_t n = 0; n < SHELL_BYTES_PER_POLL; ++n)
+	{
+		c = uart_getc(shell_uart);
+		if (c == UART_NO_DATA)
+			return n > 0;
+
+		if (c == '\r' || c == '\n')
+		{
+			line[length] = '\0';
+			if (too_long)
+				print("error: line too long\n\r");
+			else
+				Execute(line);
+			length = 0;
+			too_long = false;
+			return true;
+		}
+		if (c == '\b' || c == 0x7F)
+		{
+			if (length > 0)
+				length--;
+		}
+		else if (length < SHELL_LINE_MAX)
+			line[length++] = c;
+		else
+			too_long = true;
+	}
+	return true;
+}
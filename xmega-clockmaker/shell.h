@@ -0,0 +1,41 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+#ifndef SHELL_H
+#define SHELL_H
+
+#include "avr_compiler.h"
+#include "usart_driver.h"
+#include "commutation.h"
+
+/*! \brief Longest command line, longer lines are rejected. */
+#define SHELL_LINE_MAX 32
+
+/*! \brief Input bytes handled per shell_poll() call. */
+#define SHELL_BYTES_PER_POLL 8
+
+/*! \brief Settings the shell changes, owned by the main loop. */
+typedef struct shell_settings {
+	/* \brief Commutation mode, fixed at build time. */
+	commutation_mode_t mode;
+	/* \brief Rotation frequency in mHz. */
+	uint32_t rotation_mhz;
+	/* \brief Antennas in the array. */
+	uint8_t antennas;
+	/* \brief Frame codes on DACB CH1. */
+	bool frame_codes;
+	/* \brief Baud rate of the shell UART. */
+	uint32_t baud;
+	/* \brief 0 text, 1 telemetry frames, 2 also rotation frames. */
+	uint8_t telemetry_level;
+} shell_settings_t;
+
+void shell_init(USART_data_t *uart, shell_settings_t *settings, void (*print)(const char *s));
+bool shell_poll(void);
+
+#endif
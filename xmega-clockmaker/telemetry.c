@@ -0,0 +1,169 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+#include <string.h>
+#include <util/crc16.h>
+
+#include "avr_compiler.h"
+#include "usart_driver.h"
+#include "telemetry.h"
+
+/* Frame being built, straight in the TX buffer of the UART. */
+static USART_data_t *telemetry_uart;
+/* next free index, not visible to the transmitter until telemetry_end() */
+static uint8_t head;
+/* index of the COBS code byte of the current block, and the code so far */
+static uint8_t code_index;
+static uint8_t code;
+/* bytes left in the TX buffer, the frame is dropped when it runs out */
+static uint8_t room;
+static bool overflow;
+static uint16_t crc;
+static uint16_t dropped;
+
+/* Claims the next byte of the TX buffer. */
+static uint8_t Claim(void)
+{
+	uint8_t index = head;
+
+	if (room == 0)
+	{
+		overflow = true;
+		return index;
+	}
+	room--;
+	head = (head + 1) & telemetry_uart->buffer.TX_Mask;
+	return index;
+}
+
+/* COBS: zeros end the block, the code byte in front of it gets its length. */
+static void Stuff(uint8_t b)
+{
+	if (b == 0)
+	{
+		telemetry_uart->buffer.TX[code_index] = code;
+		code_index = Claim();
+		code = 1;
+		return;
+	}
+
+	telemetry_uart->buffer.TX[Claim()] = b;
+	if (++code == 0xFF)
+	{
+		telemetry_uart->buffer.TX[code_index] = code;
+		code_index = Claim();
+		code = 1;
+	}
+}
+
+/*! \brief Send telemetry frames on a UART.
+ *
+ *  Frames are COBS encoded (no zero bytes inside) and end with a zero byte:
+ *  a receiver that lost bytes resyncs at the next zero. Inside the encoding
+ *  are the message type, the payload and a CRC-16/XMODEM of both (low byte
+ *  first). The frames are built directly in the TX buffer of \em uart, there
+ *  is no copy. The whole frame is dropped when it does not fit.
+ *
+ *  Only call the telemetry functions from the main loop.
+ *
+ *  \param  uart  initialized UART, see init_uart()
+ */
+void telemetry_init(USART_data_t *uart)
+{
+	static const uint8_t delimiter = 0;
+
+	telemetry_uart = uart;
+	dropped = 0;
+	/* ends whatever the receiver has seen so far, the first frame is clean */
+	USART_TXBuffer_PutBytes(uart, &delimiter, 1);
+}
+
+/*! \brief Start a frame, add the payload with telemetry_put().
+ *
+ *  \param  type  message type
+ */
+void telemetry_begin(telemetry_type_t type)
+{
+	head = telemetry_uart->buffer.TX_Head;
+	room = USART_TXBuffer_FreeCount(telemetry_uart);
+	overflow = false;
+	crc = 0;
+	code = 1;
+	code_index = Claim();
+	telemetry_put(&type, 1);
+}
+
+/*! \brief Add payload bytes to the frame.
+ *
+ *  \param  data  bytes to add
+ *  \param  len   number of bytes
+ */
+void telemetry_put(const void *data, uint8_t len)
+{
+	const uint8_t *p = data;
+
+	while (len--)
+	{
+		crc = _crc_xmodem_update(crc, *p);
+		Stuff(*p++);
+	}
+}
+
+/*! \brief Finish the frame and hand it to the transmitter.
+ *
+ *  \retval true   the frame is queued
+ *  \retval false  the TX buffer was full, the frame is dropped
+ */
+bool telemetry_end(void)
+{
+	Stuff(crc & 0xFF);
+	Stuff(crc >> 8);
+	telemetry_uart->buffer.TX[code_index] = code;
+	telemetry_uart->buffer.TX[Claim()] = 0;
+
+	if (overflow)
+	{
+		dropped++;
+		return false;
+	}
+	USART_TXBuffer_Commit(telemetry_uart, head);
+	return true;
+}
+
+/*! \brief Send a frame with one payload block.
+ *
+ *  \param  type     message type
+ *  \param  payload  message contents, see telemetry_type_t
+ *  \param  len      size of \em payload
+ *
+ *  \retval true   the frame is queued
+ *  \retval false  the TX buffer was full, the frame is dropped
+ */
+bool telemetry_send(telemetry_type_t type, const void *payload, uint8_t len)
+{
+	telemetry_begin(type);
+	telemetry_put(payload, len);
+	return telemetry_end();
+}
+
+/*! \brief Send a TELEMETRY_TEXT frame.
+ *
+ *  \param  s  text, at most 255 characters are sent
+ */
+bool telemetry_text(const char *s)
+{
+	size_t len = strlen(s);
+
+	return telemetry_send(TELEMETRY_TEXT, s, len > 255 ? 255 : len);
+}
+
+/*! \brief Number of frames dropped because the TX buffer was full. */
+uint16_t telemetry_dropped(void)
+{
+	return dropped;
+}
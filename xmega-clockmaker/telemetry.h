@@ -0,0 +1,46 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "avr_compiler.h"
+#include "usart_driver.h"
+
+/*! \brief Message types, the first byte of every frame.
+ *
+ *  Payload fields are little endian. tools/telemetry_decode.c decodes them.
+ */
+typedef enum telemetry_type {
+	/* \brief Text line, the payload is the text without terminator. */
+	TELEMETRY_TEXT = 0x01,
+	/* \brief Rotation marker: uint8_t rotation number (modulo 256). */
+	TELEMETRY_ROTATION = 0x02,
+	/* \brief Bearing: uint16_t angle (65536 = 360 degrees), uint8_t quality, uint8_t overruns. */
+	TELEMETRY_BEARING = 0x03,
+	/* \brief Counters: uint16_t UART bytes dropped TX and RX, uint16_t frames dropped, uint16_t log records dropped. */
+	TELEMETRY_COUNTERS = 0x04,
+	/* \brief Log record: uint16_t flash address of the format, raw arguments, see LOG(). */
+	TELEMETRY_LOG = 0x05,
+	/* \brief Rotation start: uint8_t rotation, uint32_t CPU cycles, uint8_t timestamps lost, see timebase.h. */
+	TELEMETRY_TIMESTAMP = 0x06,
+} telemetry_type_t;
+
+/*! \brief Largest frame on the line for a payload of n bytes: type, CRC,
+ *         COBS overhead and the delimiter. */
+#define TELEMETRY_FRAME_MAX(n) ((n) + 3 + ((n) + 3) / 254 + 2)
+
+void telemetry_init(USART_data_t *uart);
+void telemetry_begin(telemetry_type_t type);
+void telemetry_put(const void *data, uint8_t len);
+bool telemetry_end(void);
+bool telemetry_send(telemetry_type_t type, const void *payload, uint8_t len);
+bool telemetry_text(const char *s);
+uint16_t telemetry_dropped(void);
+
+#endif
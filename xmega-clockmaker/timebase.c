@@ -0,0 +1,142 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "avr_compiler.h"
+#include "timebase.h"
+#include "load.h"
+
+#if TIMEBASE
+
+#define STAMP_MASK (TIMEBASE_STAMPS - 1)
+
+static timebase_stamp_t stamps[TIMEBASE_STAMPS];
+static volatile uint8_t head;
+static volatile uint8_t tail;
+static volatile uint8_t lost;
+
+/* Set by timebase_rotation(): the next capture after mark_time is a rotation start. */
+static uint32_t mark_time;
+static uint8_t mark_rotation;
+
+/*! \brief Start the cycle counter and the capture of the antenna switches.
+ *
+ *  TCC1 counts CPU cycles, its overflow clocks TCD0 through event channel 2.
+ *  Every TCC0 overflow on event channel 0 (an antenna switch) is captured
+ *  into CCA of both, TCD0 delays its capture by a cycle so a carry on the
+ *  same edge is included. Call after commutation_init(), which routes TCC0
+ *  to channel 0; in COMMUTATION_MODE_NCO there are no rotation starts to
+ *  capture.
+ */
+void timebase_init(void)
+{
+	head = 0;
+	tail = 0;
+	lost = 0;
+
+	TCC1.CTRLA = TC_CLKSEL_OFF_gc;
+	TCD0.CTRLA = TC_CLKSEL_OFF_gc;
+	TCC1.INTCTRLB = TC_CCAINTLVL_OFF_gc;
+
+	EVSYS.CH2MUX = EVSYS_CHMUX_TCC1_OVF_gc;
+
+	TCC1.CTRLB = TC1_CCAEN_bm | TC_WGMODE_NORMAL_gc;
+	TCC1.CTRLD = TC_EVACT_CAPT_gc | TC_EVSEL_CH0_gc;
+	TCC1.PER = 0xFFFF;
+	TCC1.CNT = 0;
+	TCD0.CTRLB = TC0_CCAEN_bm | TC_WGMODE_NORMAL_gc;
+	TCD0.CTRLD = TC_EVACT_CAPT_gc | TC0_EVDLY_bm | TC_EVSEL_CH0_gc;
+	TCD0.PER = 0xFFFF;
+	TCD0.CNT = 0;
+
+	TCD0.CTRLA = TC_CLKSEL_EVCH2_gc;
+	TCC1.CTRLA = TC_CLKSEL_DIV1_gc;
+}
+
+/*! \brief CPU cycles since timebase_init(), wraps after 2^32. */
+uint32_t timebase_now(void)
+{
+	uint16_t hi;
+	uint16_t lo;
+	uint16_t hi2;
+
+	AVR_ENTER_CRITICAL_REGION();
+	hi = TCD0.CNT;
+	lo = TCC1.CNT;
+	hi2 = TCD0.CNT;
+	AVR_LEAVE_CRITICAL_REGION();
+
+	/* TCC1 wrapped between the reads when the high half moved */
+	if (hi2 != hi && lo < 0x8000)
+		hi = hi2;
+	return (uint32_t)hi << 16 | lo;
+}
+
+/*! \brief Timestamp the next antenna switch as the start of \em rotation.
+ *
+ *  Called by the commutation in the last step of every rotation, the
+ *  capture interrupt only runs until it has the switch that follows.
+ */
+void timebase_rotation(uint8_t rotation)
+{
+	mark_time = timebase_now();
+	mark_rotation = rotation;
+	/* CCB belongs to pps.c */
+	TCC1.INTCTRLB = (TCC1.INTCTRLB & ~TC1_CCAINTLVL_gm) | TC_CCAINTLVL_LO_gc;
+}
+
+/*! \brief Get the next rotation start timestamp, call from the main loop.
+ *
+ *  \param  stamp  result, only written when true is returned
+ *
+ *  \retval true   a timestamp is in \em stamp
+ *  \retval false  none waiting
+ */
+bool timebase_poll(timebase_stamp_t *stamp)
+{
+	uint8_t t = tail;
+
+	if (t == head)
+		return false;
+	*stamp = stamps[t];
+	tail = (t + 1) & STAMP_MASK;
+	return true;
+}
+
+/* Empties the capture buffers, captures older than the mark are the steps
+ * before the rotation start. */
+ISR(TCC1_CCA_vect)
+{
+	LOAD_ENTER();
+
+	while (TCC1.INTFLAGS & TC1_CCAIF_bm)
+	{
+		uint16_t lo = TCC1.CCA;
+		uint32_t cycles = (uint32_t)TCD0.CCA << 16 | lo;
+		uint8_t h = head;
+
+		if ((int32_t)(cycles - mark_time) <= 0)
+			continue;
+		TCC1.INTCTRLB &= ~TC1_CCAINTLVL_gm;
+		if (((h + 1) & STAMP_MASK) == tail)
+		{
+			lost++;
+			break;
+		}
+		stamps[h].cycles = cycles;
+		stamps[h].rotation = mark_rotation;
+		stamps[h].lost = lost;
+		head = (h + 1) & STAMP_MASK;
+		break;
+	}
+	LOAD_LEAVE(LOAD_TIMEBASE);
+}
+
+#endif
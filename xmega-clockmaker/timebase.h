@@ -0,0 +1,39 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include "avr_compiler.h"
+
+/*! \brief 32 bit cycle counter on TCC1/TCD0 with rotation start timestamps,
+ *         0 frees TCC1, TCD0 and event channel 2.
+ */
+#ifndef TIMEBASE
+#define TIMEBASE 1
+#endif
+
+/*! \brief Timestamps held until timebase_poll(), a power of two. */
+#define TIMEBASE_STAMPS 8
+
+/*! \brief Time of one rotation start, see timebase_poll(). */
+typedef struct timebase_stamp {
+	/* \brief CPU cycles since timebase_init() at the switch to antenna 0, wraps. */
+	uint32_t cycles;
+	/* \brief Rotation number, like commutation_rotation(). */
+	uint8_t rotation;
+	/* \brief Timestamps lost because they were not polled in time. */
+	uint8_t lost;
+} timebase_stamp_t;
+
+void timebase_init(void);
+uint32_t timebase_now(void);
+void timebase_rotation(uint8_t rotation);
+bool timebase_poll(timebase_stamp_t *stamp);
+
+#endif
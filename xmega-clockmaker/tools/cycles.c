@@ -0,0 +1,335 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+/* Static cycle budget of firmware functions, used by make cycle-budget.
+ *
+ *   avr-objdump -d myproject.out | ./cycles [-b budget] [-w out] label:symbol ...
+ *
+ * Adds up the XMEGA cycles of every instruction of each function once:
+ * branches and skips not taken, loops once, calls and returns at their own
+ * cost with the 3 byte return address of the ATxmega256A3U. A CALL, RCALL or
+ * a JMP/RJMP to the start of another function adds that function's count,
+ * whole, so an ISR that calls its handler includes it; calls through a
+ * pointer (ICALL) are not followed. That is a measure of the code, close to
+ * its size, and not the time of any path through it: it only grows when the
+ * code does, which is what the budget is for.
+ *
+ * With -b every label above its budget fails, and so does a label that is
+ * missing from the listing or the budget file: the exit status is 1.
+ * -w writes the counts as a new budget instead.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PATHS_MAX 64
+
+typedef struct path {
+	const char *label;
+	const char *symbol;
+	long cycles;
+	long words;
+	long budget;
+} path_t;
+
+typedef struct timing {
+	const char *mnemonic;
+	int cycles;
+} timing_t;
+
+/* Every function in the listing, with the functions it calls. */
+typedef struct function {
+	char *symbol;
+	long cycles;
+	long words;
+	char **callees;
+	int callee_count;
+	/* total with the callees: -1 not yet known, -2 being added up */
+	long total;
+} function_t;
+
+/* AVRxm cycles, 22 bit program counter. Not listed: 1 cycle, STD too. Loads
+ * at their I/O timing: from the internal SRAM they take one more, which only
+ * LDS shows in the listing. */
+static const timing_t timings[] = {
+	{ "adiw", 2 }, { "sbiw", 2 },
+	{ "mul", 2 }, { "muls", 2 }, { "mulsu", 2 }, { "fmul", 2 }, { "fmuls", 2 }, { "fmulsu", 2 },
+	{ "rjmp", 2 }, { "ijmp", 2 }, { "eijmp", 2 }, { "jmp", 3 },
+	{ "rcall", 3 }, { "icall", 3 }, { "eicall", 4 }, { "call", 4 },
+	{ "ret", 5 }, { "reti", 5 },
+	{ "sbic", 2 }, { "sbis", 2 },
+	{ "ld", 1 }, { "ldd", 2 }, { "lds", 2 },
+	{ "st", 1 }, { "sts", 2 },
+	{ "lpm", 3 }, { "elpm", 3 },
+	{ "pop", 2 },
+	{ "xch", 2 }, { "las", 2 }, { "lac", 2 }, { "lat", 2 },
+};
+
+static path_t paths[PATHS_MAX];
+static int path_count;
+
+static function_t *functions;
+static int function_count;
+
+static void *Grow(void *p, size_t size)
+{
+	p = realloc(p, size);
+	if (!p)
+	{
+		perror("cycles");
+		exit(2);
+	}
+	return p;
+}
+
+static int Cycles(const char *mnemonic, const char *operands)
+{
+	for (size_t i = 0; i < sizeof(timings) / sizeof(timings[0]); ++i)
+	{
+		if (strcmp(mnemonic, timings[i].mnemonic) != 0)
+			continue;
+		/* LD -X, ST -X and friends take one more */
+		if ((strcmp(mnemonic, "ld") == 0 || strcmp(mnemonic, "st") == 0) && strchr(operands, '-'))
+			return timings[i].cycles + 1;
+		/* the internal SRAM is above the peripherals */
+		if (strcmp(mnemonic, "lds") == 0)
+		{
+			const char *addr = strrchr(operands, ',');
+
+			if (addr && strtol(addr + 1, NULL, 0) >= 0x2000)
+				return timings[i].cycles + 1;
+		}
+		return timings[i].cycles;
+	}
+	return 1;
+}
+
+static function_t *FindFunction(const char *symbol)
+{
+	for (int i = 0; i < function_count; ++i)
+		if (strcmp(functions[i].symbol, symbol) == 0)
+			return &functions[i];
+	return NULL;
+}
+
+static function_t *AddFunction(const char *symbol)
+{
+	function_t *f;
+
+	functions = Grow(functions, (function_count + 1) * sizeof(function_t));
+	f = &functions[function_count++];
+	memset(f, 0, sizeof(*f));
+	f->symbol = strdup(symbol);
+	f->total = -1;
+	return f;
+}
+
+/* "call 0x1a2 ; 0x1a2 <name>": the function a call or jump enters, NULL for
+ * a target inside a function (a branch) or for the function itself. */
+static const char *Callee(const function_t *f, const char *mnemonic, char *line)
+{
+	char *start;
+	char *end;
+
+	if (strcmp(mnemonic, "call") != 0 && strcmp(mnemonic, "rcall") != 0 &&
+	    strcmp(mnemonic, "jmp") != 0 && strcmp(mnemonic, "rjmp") != 0)
+		return NULL;
+	start = strrchr(line, '<');
+	end = start ? strchr(start, '>') : NULL;
+	if (!end)
+		return NULL;
+	*end = '\0';
+	start++;
+	if (strchr(start, '+') || strcmp(start, f->symbol) == 0)
+		return NULL;
+	return start;
+}
+
+/* Cycles of a function with everything it calls, a recursive call counts once. */
+static long Total(function_t *f)
+{
+	long total;
+
+	if (f->total == -2)
+		return 0;
+	if (f->total >= 0)
+		return f->total;
+
+	f->total = -2;
+	total = f->cycles;
+	for (int i = 0; i < f->callee_count; ++i)
+	{
+		function_t *callee = FindFunction(f->callees[i]);
+
+		if (callee)
+			total += Total(callee);
+	}
+	f->total = total;
+	return total;
+}
+
+static void ReadListing(FILE *in)
+{
+	char line[512];
+	function_t *current = NULL;
+
+	while (fgets(line, sizeof(line), in))
+	{
+		char *start = strchr(line, '<');
+		char mnemonic[16];
+		char operands[128] = "";
+		char *field;
+		const char *callee;
+
+		/* "00000abc <symbol>:" starts a function */
+		if (line[0] != ' ' && start && strstr(start, ">:"))
+		{
+			*strstr(start, ">:") = '\0';
+			current = FindFunction(start + 1);
+			if (!current)
+				current = AddFunction(start + 1);
+			continue;
+		}
+		if (!current)
+			continue;
+		if (line[0] == '\n')
+		{
+			current = NULL;
+			continue;
+		}
+
+		/* "     abc:\t1f 92       \tpush\tr1" */
+		field = strchr(line, '\t');
+		if (!field || !(field = strchr(field + 1, '\t')))
+			continue;
+		if (sscanf(field + 1, "%15s %127[^\n;]", mnemonic, operands) < 1 || mnemonic[0] == '.')
+			continue;
+		current->cycles += Cycles(mnemonic, operands);
+		current->words++;
+
+		callee = Callee(current, mnemonic, line);
+		if (callee)
+		{
+			current->callees = Grow(current->callees, (current->callee_count + 1) * sizeof(char *));
+			current->callees[current->callee_count++] = strdup(callee);
+		}
+	}
+}
+
+static void ReadBudget(const char *file)
+{
+	FILE *f = fopen(file, "r");
+	char label[128];
+	long cycles;
+
+	if (!f)
+	{
+		fprintf(stderr, "%s: no budget, make cycle-budget-update writes one\n", file);
+		return;
+	}
+	while (fscanf(f, "%127s %ld", label, &cycles) == 2)
+		for (int i = 0; i < path_count; ++i)
+			if (strcmp(paths[i].label, label) == 0)
+				paths[i].budget = cycles;
+	fclose(f);
+}
+
+int main(int argc, char **argv)
+{
+	const char *budget = NULL;
+	const char *write = NULL;
+	int failed = 0;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		char *colon;
+
+		if (strcmp(argv[i], "-b") == 0 && i + 1 < argc)
+			budget = argv[++i];
+		else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+			write = argv[++i];
+		else if (path_count < PATHS_MAX)
+		{
+			colon = strchr(argv[i], ':');
+			paths[path_count].label = argv[i];
+			paths[path_count].symbol = argv[i];
+			if (colon)
+			{
+				*colon = '\0';
+				paths[path_count].symbol = colon + 1;
+			}
+			paths[path_count].cycles = -1;
+			paths[path_count].budget = -1;
+			path_count++;
+		}
+	}
+	if (path_count == 0)
+	{
+		fprintf(stderr, "usage: avr-objdump -d elf | %s [-b budget] [-w out] label:symbol ...\n", argv[0]);
+		return 2;
+	}
+
+	ReadListing(stdin);
+	for (int i = 0; i < path_count; ++i)
+	{
+		function_t *f = FindFunction(paths[i].symbol);
+
+		if (f)
+		{
+			paths[i].cycles = Total(f);
+			paths[i].words = f->words;
+		}
+	}
+
+	if (budget)
+		ReadBudget(budget);
+
+	printf("%-24s %8s %8s %8s\n", "path", "cycles", "words", "budget");
+	for (int i = 0; i < path_count; ++i)
+	{
+		path_t *p = &paths[i];
+
+		if (p->cycles < 0)
+		{
+			printf("%-24s %8s\n", p->label, "missing");
+			failed++;
+			continue;
+		}
+		printf("%-24s %8ld %8ld", p->label, p->cycles, p->words);
+		if (p->budget >= 0)
+			printf(" %8ld%s", p->budget, p->cycles > p->budget ? "  OVER" : "");
+		else if (budget)
+			printf(" %8s", "none");
+		putchar('\n');
+		if (budget && (p->budget < 0 || p->cycles > p->budget))
+			failed++;
+	}
+
+	if (write)
+	{
+		FILE *f = fopen(write, "w");
+
+		if (!f)
+		{
+			perror(write);
+			return 2;
+		}
+		for (int i = 0; i < path_count; ++i)
+			if (paths[i].cycles >= 0)
+				fprintf(f, "%s %ld\n", paths[i].label, paths[i].cycles);
+		fclose(f);
+		return 0;
+	}
+
+	if (failed && budget)
+		fprintf(stderr, "%d path(s) missing or over the budget in %s\n", failed, budget);
+	else if (failed)
+		fprintf(stderr, "%d path(s) missing from the listing\n", failed);
+	return failed ? 1 : 0;
+}
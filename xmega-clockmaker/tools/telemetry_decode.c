@@ -0,0 +1,355 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+/* Host decoder for the telemetry frames of telemetry.c.
+ *
+ *   cc -O2 -o telemetry_decode tools/telemetry_decode.c
+ *   ./telemetry_decode /dev/ttyUSB0 230400
+ *   ./telemetry_decode -e xmega-clockmaker.out < capture.bin
+ *
+ * Prints one line per frame, bad frames (CRC, COBS) are counted and skipped.
+ * LOG() records are expanded with the format strings from the ELF file given
+ * with -e, which has to be the build running on the device.
+ */
+
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define FRAME_MAX 512
+
+enum {
+	TELEMETRY_TEXT = 0x01,
+	TELEMETRY_ROTATION = 0x02,
+	TELEMETRY_BEARING = 0x03,
+	TELEMETRY_COUNTERS = 0x04,
+	TELEMETRY_LOG = 0x05,
+	TELEMETRY_TIMESTAMP = 0x06,
+};
+
+/* Allocated sections of the ELF file, the log formats are in .text. */
+static Elf32_Shdr *sections;
+static unsigned section_count;
+static uint8_t *elf;
+static size_t elf_size;
+
+static unsigned long frames;
+static unsigned long bad;
+
+static uint16_t Crc16Xmodem(const uint8_t *p, size_t len)
+{
+	uint16_t crc = 0;
+
+	while (len--)
+	{
+		crc ^= (uint16_t)*p++ << 8;
+		for (int i = 0; i < 8; ++i)
+			crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+	}
+	return crc;
+}
+
+/* Decodes one COBS block sequence without the zero delimiter, returns the
+ * decoded length or -1. */
+static int CobsDecode(const uint8_t *in, size_t len, uint8_t *out)
+{
+	size_t i = 0;
+	size_t n = 0;
+
+	while (i < len)
+	{
+		uint8_t code = in[i++];
+
+		if (code == 0 || i + code - 1 > len)
+			return -1;
+		for (uint8_t k = 1; k < code; ++k)
+			out[n++] = in[i++];
+		if (code != 0xFF && i < len)
+			out[n++] = 0;
+	}
+	return n;
+}
+
+static uint16_t U16(const uint8_t *p)
+{
+	return p[0] | p[1] << 8;
+}
+
+static void LoadElf(const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	Elf32_Ehdr *eh;
+
+	if (!f)
+	{
+		fprintf(stderr, "%s: %s\n", path, strerror(errno));
+		exit(1);
+	}
+	fseek(f, 0, SEEK_END);
+	elf_size = ftell(f);
+	rewind(f);
+	elf = malloc(elf_size);
+	if (!elf || fread(elf, 1, elf_size, f) != elf_size)
+	{
+		fprintf(stderr, "%s: read error\n", path);
+		exit(1);
+	}
+	fclose(f);
+
+	eh = (Elf32_Ehdr *)elf;
+	if (elf_size < sizeof(*eh) || memcmp(eh->e_ident, ELFMAG, SELFMAG) ||
+	    eh->e_ident[EI_CLASS] != ELFCLASS32 ||
+	    eh->e_shoff + (size_t)eh->e_shnum * sizeof(Elf32_Shdr) > elf_size)
+	{
+		fprintf(stderr, "%s: not a 32 bit ELF file\n", path);
+		exit(1);
+	}
+	sections = (Elf32_Shdr *)(elf + eh->e_shoff);
+	section_count = eh->e_shnum;
+}
+
+/* Format string at flash address \em addr, NULL if it is not in the ELF. */
+static const char *LogFormat(uint16_t addr)
+{
+	for (unsigned i = 0; i < section_count; ++i)
+	{
+		const Elf32_Shdr *sh = &sections[i];
+
+		if (sh->sh_type != SHT_PROGBITS || !(sh->sh_flags & SHF_ALLOC) ||
+		    addr < sh->sh_addr || addr >= sh->sh_addr + sh->sh_size ||
+		    sh->sh_offset + sh->sh_size > elf_size)
+			continue;
+		if (!memchr(elf + sh->sh_offset + (addr - sh->sh_addr), 0,
+		            sh->sh_addr + sh->sh_size - addr))
+			return NULL;
+		return (const char *)elf + sh->sh_offset + (addr - sh->sh_addr);
+	}
+	return NULL;
+}
+
+/* printf with the AVR argument sizes: int 2 bytes, long 4, double 4. */
+static void Log(const uint8_t *p, int n)
+{
+	const char *fmt = LogFormat(U16(p));
+	const uint8_t *arg = p + 2;
+	const uint8_t *end = p + n;
+
+	if (!fmt)
+	{
+		printf("log       format 0x%04x not in the ELF file (-e)\n", U16(p));
+		return;
+	}
+	printf("log       ");
+	while (*fmt)
+	{
+		char spec[16];
+		size_t len;
+		int size;
+		bool is_long = false;
+
+		if (*fmt != '%')
+		{
+			putchar(*fmt++);
+			continue;
+		}
+		len = strspn(fmt + 1, "-+ #0123456789.");
+		if (fmt[1 + len] == 'l')
+			is_long = true;
+		len += 1 + is_long;
+		if (fmt[len] == '%' || !fmt[len] || len + 2 > sizeof(spec))
+		{
+			putchar('%');
+			fmt += fmt[len] == '%' ? len + 1 : 1;
+			continue;
+		}
+		memcpy(spec, fmt, len + 1);
+		spec[len + 1] = 0;
+		fmt += len + 1;
+
+		size = is_long || strchr("eEfFgG", spec[len]) ? 4 : 2;
+		if (arg + size > end)
+		{
+			printf("<missing>");
+			continue;
+		}
+		if (strchr("eEfFgG", spec[len]))
+		{
+			float f;
+
+			memcpy(&f, arg, 4);
+			printf(spec, (double)f);
+		}
+		else if (strchr("di", spec[len]))
+			printf(spec, is_long ? (long)(int32_t)(U16(arg) | (uint32_t)U16(arg + 2) << 16)
+			                     : (long)(int16_t)U16(arg));
+		else if (strchr("uxXoc", spec[len]))
+			printf(spec, is_long ? (unsigned long)(U16(arg) | (uint32_t)U16(arg + 2) << 16)
+			                     : (unsigned long)U16(arg));
+		else
+			printf("<%s>", spec);
+		arg += size;
+	}
+	putchar('\n');
+}
+
+static void Frame(const uint8_t *raw, size_t len)
+{
+	uint8_t msg[FRAME_MAX];
+	int n = CobsDecode(raw, len, msg);
+
+	if (n < 3 || Crc16Xmodem(msg, n - 2) != U16(msg + n - 2))
+	{
+		bad++;
+		fprintf(stderr, "bad frame (%zu bytes), %lu so far\n", len, bad);
+		return;
+	}
+	frames++;
+	n -= 3;
+
+	switch (msg[0])
+	{
+	case TELEMETRY_TEXT:
+		printf("text      %.*s\n", n, (const char *)msg + 1);
+		break;
+	case TELEMETRY_ROTATION:
+		if (n >= 1)
+		{
+			printf("rotation  %u\n", msg[1]);
+			break;
+		}
+		goto unknown;
+	case TELEMETRY_BEARING:
+		if (n >= 4)
+		{
+			printf("bearing   %.1f deg q=%u%% overruns=%u\n",
+			       U16(msg + 1) * 360.0 / 65536, msg[3], msg[4]);
+			break;
+		}
+		goto unknown;
+	case TELEMETRY_COUNTERS:
+		if (n >= 8)
+		{
+			printf("counters  uart tx dropped %u rx dropped %u, frames dropped %u, log dropped %u\n",
+			       U16(msg + 1), U16(msg + 3), U16(msg + 5), U16(msg + 7));
+			break;
+		}
+		goto unknown;
+	case TELEMETRY_TIMESTAMP:
+		if (n >= 6)
+		{
+			printf("timestamp rotation %u at cycle %lu, %u lost\n", msg[1],
+			       (unsigned long)(U16(msg + 2) | (uint32_t)U16(msg + 4) << 16), msg[6]);
+			break;
+		}
+		goto unknown;
+	case TELEMETRY_LOG:
+		if (n >= 2)
+		{
+			Log(msg + 1, n);
+			break;
+		}
+		goto unknown;
+	default:
+	unknown:
+		printf("type 0x%02x, %d bytes\n", msg[0], n);
+		break;
+	}
+	fflush(stdout);
+}
+
+static speed_t Speed(long baud)
+{
+	switch (baud)
+	{
+	case 9600: return B9600;
+	case 19200: return B19200;
+	case 38400: return B38400;
+	case 57600: return B57600;
+	case 115200: return B115200;
+	case 230400: return B230400;
+#ifdef B460800
+	case 460800: return B460800;
+#endif
+#ifdef B921600
+	case 921600: return B921600;
+#endif
+#ifdef B1000000
+	case 1000000: return B1000000;
+#endif
+#ifdef B2000000
+	case 2000000: return B2000000;
+#endif
+	}
+	fprintf(stderr, "unsupported baud rate %ld\n", baud);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	uint8_t raw[FRAME_MAX];
+	uint8_t buf[256];
+	size_t len = 0;
+	int fd = 0;
+	ssize_t got;
+
+	if (argc > 2 && strcmp(argv[1], "-e") == 0)
+	{
+		LoadElf(argv[2]);
+		argc -= 2;
+		argv += 2;
+	}
+	if (argc > 1)
+	{
+		fd = open(argv[1], O_RDONLY | O_NOCTTY);
+		if (fd < 0)
+		{
+			fprintf(stderr, "%s: %s\n", argv[1], strerror(errno));
+			return 1;
+		}
+	}
+	if (isatty(fd))
+	{
+		struct termios tio;
+
+		tcgetattr(fd, &tio);
+		cfmakeraw(&tio);
+		if (argc > 2)
+		{
+			cfsetispeed(&tio, Speed(atol(argv[2])));
+			cfsetospeed(&tio, Speed(atol(argv[2])));
+		}
+		tcsetattr(fd, TCSANOW, &tio);
+	}
+
+	while ((got = read(fd, buf, sizeof(buf))) > 0)
+	{
+		for (ssize_t i = 0; i < got; ++i)
+		{
+			if (buf[i] == 0)
+			{
+				if (len > 0 && len <= sizeof(raw))
+					Frame(raw, len);
+				else if (len > sizeof(raw))
+					bad++;
+				len = 0;
+			}
+			else if (len++ < sizeof(raw))
+				raw[len - 1] = buf[i];
+		}
+	}
+
+	fprintf(stderr, "%lu frames, %lu bad\n", frames, bad);
+	return 0;
+}
@@ -36,7 +36,7 @@
  */
 
 #include <avr/io.h>
-#include <math.h>
+#include <string.h>
 #include "avr_compiler.h"
 #include "usart_driver.h"
 #include "uart.h"
@@ -66,13 +66,14 @@ uint16_t uart_getc(USART_data_t *uart)
  *  \param  uart      pointer to UART datastructure with buffers
  *  \param  data      byte to be written
  *
+ *  If the buffer is full the overflow policy of the UART applies, see
+ *  uart_write.
+ *
  *  \return void
  */
 void uart_putc(USART_data_t *uart, uint8_t data)
 {
-  if ( USART_TXBuffer_FreeSpace(uart) ) {
-    USART_TXBuffer_PutByte(uart, data);
-  }
+  uart_write(uart, &data, 1);
 }
 
 /*! \brief Write a string to the circulair transmit buffer
@@ -84,11 +85,112 @@ void uart_putc(USART_data_t *uart, uint8_t data)
  */
 void uart_puts(USART_data_t *uart, char *s)
 {
-  char c;
+  uart_write(uart, s, strlen(s));
+}
+
+/*! \brief Write a block of data to the circular transmit buffer
+ *
+ *  \param  uart      pointer to UART datastructure with buffers
+ *  \param  buf       data to be written
+ *  \param  len       number of bytes in \em buf
+ *
+ *  The data is copied in spans as large as the free space and the transmitter
+ *  is started once per span. When the buffer is full the policy set with
+ *  uart_set_policy applies:
+ *  - UART_DROP_NEWEST: the rest of \em buf is dropped,
+ *  - UART_DROP_OLDEST: the oldest bytes in the buffer that are not sent yet
+ *    make room, if \em buf is larger than the buffer only its end is kept,
+ *  - UART_BLOCK: wait until everything is in the buffer. Do not use it with
+ *    interrupts disabled or from an interrupt of the same or a higher level
+ *    than the transmitter.
+ *
+ *  Dropped bytes are counted, see uart_dropped.
+ *
+ *  \return number of bytes of \em buf that were written to the buffer
+ */
+uint16_t uart_write(USART_data_t *uart, const void *buf, uint16_t len)
+{
+  const uint8_t *p = buf;
+  uint16_t written = 0;
+  uint8_t  span;
+  uint8_t  room;
 
-  while ( (c = *s++) ) {
-    uart_putc(uart, c);
+  if ( uart->txPolicy == UART_DROP_OLDEST ) {
+    if ( len > uart->buffer.TX_Mask ) {
+      uart->txDropped += len - uart->buffer.TX_Mask;
+      p   += len - uart->buffer.TX_Mask;
+      len  = uart->buffer.TX_Mask;
+    }
+    room = USART_TXBuffer_FreeCount(uart);
+    if ( len > room ) {
+      uart->txDropped += USART_TXBuffer_Discard(uart, len - room);
+    }
   }
+
+  while ( written < len ) {
+    span = (len - written > uart->buffer.TX_Mask) ? uart->buffer.TX_Mask : len - written;
+    span = USART_TXBuffer_PutBytes(uart, p + written, span);
+    written += span;
+    if ( span == 0 && uart->txPolicy != UART_BLOCK ) {
+      uart->txDropped += len - written;
+      break;
+    }
+  }
+
+  return written;
+}
+
+/*! \brief Read a block of data from the circular receive buffer
+ *
+ *  \param  uart      pointer to UART datastructure with buffers
+ *  \param  buf       destination of the received data
+ *  \param  len       size of \em buf
+ *
+ *  \return number of bytes copied to \em buf, 0 if nothing was received
+ */
+uint16_t uart_read(USART_data_t *uart, void *buf, uint16_t len)
+{
+  uint8_t *p = buf;
+  uint16_t count = 0;
+  uint8_t  span;
+
+  do {
+    span = (len - count > 255) ? 255 : len - count;
+    span = USART_RXBuffer_GetBytes(uart, p + count, span);
+    count += span;
+  } while ( span != 0 && count < len );
+
+  return count;
+}
+
+/*! \brief Sets what uart_write does when the transmit buffer is full
+ *
+ *  \param  uart      pointer to UART datastructure with buffers
+ *  \param  policy    UART_DROP_NEWEST (default), UART_DROP_OLDEST or UART_BLOCK
+ *
+ *  \return void
+ */
+void uart_set_policy(USART_data_t *uart, uart_policy_t policy)
+{
+  uart->txPolicy = policy;
+}
+
+/*! \brief Gets the number of dropped bytes
+ *
+ *  \param  uart      pointer to UART datastructure with buffers
+ *  \param  tx        bytes uart_write dropped because the transmit buffer was full
+ *  \param  rx        received bytes dropped because the receive buffer was full
+ *
+ *  Both counters wrap at 65536, they are cleared by init_uart.
+ *
+ *  \return void
+ */
+void uart_dropped(USART_data_t *uart, uint16_t *tx, uint16_t *rx)
+{
+  *tx = uart->txDropped;
+  AVR_ENTER_CRITICAL_REGION();
+  *rx = uart->rxDropped;
+  AVR_LEAVE_CRITICAL_REGION();
 }
 
 /*! \brief Set direction for the transmit and receive pin
@@ -157,72 +259,100 @@ void set_usart_txrx_direction(USART_t *usart)
   #endif
 }
 
-/*! \brief Calculates the baud rate value BSEL
- *
- *  \param  f_cpu       system clock (F_CPU)
- *  \param  baud        desired baud rate
- *  \param  scale       scale factor (BSCALE)
- *  \param  clk2x       clock speed double (1 for double, 0 for no double)
- *
- *  It calculates the baud selection value BSEL from the system clock,
- *  the baud rate, the scale factor and a boolean for clock doubling.
- *
- *  The formula to calculate BSEL is:
- *  \f{eqnarray*}{
- *      \mbox{BSCALE}>=0\quad &:& \quad
- *      \mbox{BSEL} =  \frac{f_{\mbox{cpu}}}{N\ 2^{\mbox{BSCALE}}\ f_{\mbox{baud}}} - 1 \\[3pt]
- *      \mbox{BSCALE}<0\quad  &:& \quad
- *      \mbox{BSEL} =  \frac{1}{2^{\mbox{BSCALE}}}\
- *                     \left( \frac{f_{\mbox{cpu}}}{N\ f_{\mbox{baud}}} - 1 \right)
- *  \f}
- *  N is a factor which is 16 with no clock doubling and 8 with clock doubling
- *
- *  \return the calculated BSEL
+/*! \brief Works out the baud rate registers for a baud rate
+ *
+ *  \param  f_cpu     system clock (F_CPU)
+ *  \param  baud      desired baud rate
+ *  \param  setting   BSEL, BSCALE and CLK2X, only written if the rate is
+ *                    possible
+ *
+ *  The run time version of BAUD_SETTING in uart_baud.h, for a rate that is
+ *  not known at compile time: for normal and for double speed the most
+ *  negative BSCALE that fits BSEL in 12 bits, double speed only when it is
+ *  more accurate. Integer arithmetic only.
+ *
+ *  \return true if the rate is at most BAUD_MAX_ERROR_PPM off
  */
-uint16_t calc_bsel(uint32_t f_cpu, uint32_t baud, int8_t scale, uint8_t clk2x)
+bool uart_calc_baud(uint32_t f_cpu, uint32_t baud, uart_baud_t *setting)
 {
-  uint8_t factor = 16;
+  uint32_t best = UINT32_MAX;
+  uart_baud_t found;
+  uint8_t  clk2x;
+  int8_t   bscale;
 
-  factor = factor >> (clk2x & 0x01);
-  if ( scale < 0 ) {
-    return round(  (((double)(f_cpu)/(factor*(double)(baud))) - 1) * (1<<-(scale))  );
-  } else {
-    return round(  ((double)(f_cpu)/(factor*(double)(baud))/(1<<(scale))) - 1);
+  if ( baud == 0 ) return false;
+
+  for (clk2x = 0; clk2x < 2; clk2x++) {
+    for (bscale = -7; bscale < 8; bscale++) {
+      uint32_t p = bscale < 0 ? 1 : 1UL << bscale;
+      uint32_t k = bscale < 0 ? 1UL << -bscale : 1;
+      uint64_t bsel = UART_BAUD_BSEL(f_cpu, baud, clk2x, p, k);
+      uint32_t error;
+
+      if ( bsel >= 4096 ) continue;
+      error = UART_BAUD_ERROR_PPM(f_cpu, baud, clk2x, p, k);
+      if ( error < best ) {
+        best = error;
+        found.bsel   = bsel;
+        found.bscale = bscale;
+        found.clk2x  = clk2x;
+      }
+      break;
+    }
   }
+
+  /* a refused rate leaves a setting still waiting to be applied alone */
+  if ( best > BAUD_MAX_ERROR_PPM ) return false;
+  *setting = found;
+  return true;
 }
 
-/*! \brief Determines the scale factor BSCALE
+/*! \brief Changes the baud rate of an initialized UART
  *
- *  \param  f_cpu       system clock (F_CPU)
- *  \param  baud        desired baud rate
- *  \param  clk2x       clock speed double (1 for double, 0 for no double)
+ *  \param  uart    pointer to a UART datastructure with buffers
+ *  \param  baud    BSEL, BSCALE and CLK2X, from BAUD_SETTING or uart_calc_baud
  *
- *  It determines the scale factor BSCALE from the system clock, the baud rate,
- *  and a boolean for clock doubling.
+ *  Only the baud rate registers and CLK2X are written, the buffers and
+ *  settings stay. A character that is being sent or received gets
+ *  corrupted, wait for uart_tx_idle first.
  *
- *  \return the scale factor BSCALE
+ *  \return void
  */
-int8_t calc_bscale(uint32_t f_cpu, uint32_t baud, uint8_t clk2x)
+void uart_set_baud(USART_data_t *uart, uart_baud_t baud)
 {
-  int8_t   bscale;
-  uint16_t bsel;
+  USART_Baudrate_Set(uart->usart, baud.bsel, baud.bscale);
+  if ( baud.clk2x ) {
+    uart->usart->CTRLB |= USART_CLK2X_bm;
+  } else {
+    uart->usart->CTRLB &= ~USART_CLK2X_bm;
+  }
+}
 
-  for (bscale = -7; bscale<8; bscale++) {
-    if ( (bsel = calc_bsel(f_cpu, baud, bscale, clk2x)) < 4096 ) return bscale;
+/*! \brief Tests if everything in the transmit buffer is on the line
+ *
+ *  \param  uart    pointer to a UART datastructure with buffers
+ *
+ *  The transmit complete flag TXCIF is cleared when the buffer is not empty,
+ *  so it is only set by a character written after that.
+ *
+ *  \return true if the buffer is empty and the last character is sent
+ */
+bool uart_tx_idle(USART_data_t *uart)
+{
+  if ( uart->buffer.TX_Head != uart->buffer.TX_Tail ) {
+    uart->usart->STATUS = USART_TXCIF_bm;
+    return false;
   }
 
-  return bscale;
+  return (uart->usart->STATUS & USART_TXCIF_bm) != 0;
 }
 
 /*! \brief Initializes the UART
  *
  *  \param  uart    pointer to a UART datastructure with buffers
  *  \param  usart   pointer to a UART datastructure
- *  \param  f_cpu   system clock (F_CPU)
- *  \param  baud    desired baud rate
- *  \param  clk2x   clock speed double (1 for double, 0 for no double)
+ *  \param  baud    BSEL, BSCALE and CLK2X, from BAUD_SETTING or uart_calc_baud
  *
- *  It calculates the scale factor BSCALE and the baud selection value BSEL.
  *  It selects what USART module to use and it initializes receive and transmit buffer.
  *  It initializes the USART module and sets the direction of TXD and RXD pin.
  *  The interrupt levels of the DRE interrupt function and the RXC interrupt function
@@ -230,20 +360,14 @@ int8_t calc_bscale(uint32_t f_cpu, uint32_t baud, uint8_t clk2x)
  *
  *  \return void
  */
-void init_uart(USART_data_t *uart, USART_t *usart, uint32_t f_cpu, uint32_t baud, uint8_t clk2x)
+void init_uart(USART_data_t *uart, USART_t *usart, uart_baud_t baud)
 {
-  uint16_t bsel;
-  int8_t bscale;
-
-  bscale = calc_bscale(f_cpu, baud, clk2x);
-  bsel   = calc_bsel(f_cpu, baud, bscale, clk2x);
-
   USART_InterruptDriver_Initialize(uart, usart, USART_DREINTLVL_LO_gc);
   USART_Format_Set(uart->usart, USART_CHSIZE_8BIT_gc, USART_PMODE_DISABLED_gc, !USART_SBMODE_bm);
   USART_Rx_Enable(uart->usart);
   USART_Tx_Enable(uart->usart);
   USART_RxdInterruptLevel_Set(uart->usart, USART_RXCINTLVL_LO_gc);
-  USART_Baudrate_Set(uart->usart, bsel, bscale);
+  uart_set_baud(uart, baud);
 
   set_usart_txrx_direction(uart->usart);
 }
@@ -252,13 +376,10 @@ void init_uart(USART_data_t *uart, USART_t *usart, uint32_t f_cpu, uint32_t baud
  *
  *  \param  uart    pointer to a UART datastructure with buffers
  *  \param  usart   pointer to a UART datastructure (UART module)
- *  \param  f_cpu   system clock (F_CPU)
- *  \param  baud    desired baud rate
- *  \param  clk2x   clock speed double (1 for double, 0 for no double)
+ *  \param  baud    BSEL, BSCALE and CLK2X, from BAUD_SETTING or uart_calc_baud
  *  \param  rxcIntLevel   RXC interrupt level
  *  \param  dreIntLevel   DRE interrupt level
  *
- *  It calculates the scale factor BSCALE and the baud selection value BSEL.
  *  It selects what USART module to use and it initializes receive and transmit buffer.
  *  It initializes the USART module and sets the direction of TXD and RXD pin.
  *  The interrupt level of the DRE interrupt function and the RXC interrupt function
@@ -267,21 +388,89 @@ void init_uart(USART_data_t *uart, USART_t *usart, uint32_t f_cpu, uint32_t baud
  *  \return void
  */
 void init_uart_levels(USART_data_t *uart, USART_t *usart,
-                      uint32_t f_cpu, uint32_t baud, uint8_t clk2x,
+                      uart_baud_t baud,
                       USART_RXCINTLVL_t  rxcIntLevel, USART_DREINTLVL_t dreIntLevel)
 {
-  uint16_t bsel;
-  int8_t bscale;
-
-  bscale = calc_bscale(f_cpu, baud, clk2x);
-  bsel   = calc_bsel(f_cpu, baud, bscale, clk2x);
-
   USART_InterruptDriver_Initialize(uart, usart, dreIntLevel);
   USART_Format_Set(uart->usart, USART_CHSIZE_8BIT_gc, USART_PMODE_DISABLED_gc, !USART_SBMODE_bm);
   USART_Rx_Enable(uart->usart);
   USART_Tx_Enable(uart->usart);
   USART_RxdInterruptLevel_Set(uart->usart, rxcIntLevel);
-  USART_Baudrate_Set(uart->usart, bsel, bscale);
+  uart_set_baud(uart, baud);
 
   set_usart_txrx_direction(uart->usart);
+}
+
+/*! \brief Transmit with a DMA channel instead of the DRE interrupt
+ *
+ *  \param  uart      pointer to a UART datastructure with buffers
+ *  \param  channel   DMA channel (0 to 3)
+ *
+ *  The DMA channel sends the transmit buffer in contiguous chunks, triggered
+ *  by the data register empty flag of the UART. It costs one interrupt per
+ *  chunk instead of one per byte. Call it right after init_uart or
+ *  init_uart_levels and define in the code just before including uart.h
+ *  the macro UART_TX_DMA_\em uart_id with the same channel, for example:
+ * \verbatim
+      #define ENABLE_UART_F0 1
+      #define UART_TX_DMA_F0 2
+      #include <uart.h>
+      ...
+      uart_tx_dma(&uartF0, UART_TX_DMA_F0);
+   \endverbatim
+ *
+ *  \return void
+ */
+void uart_tx_dma(USART_data_t *uart, uint8_t channel)
+{
+  DMA_CH_t *dma = &DMA.CH0 + channel;
+
+  #ifdef USARTC0
+   if ( (uint16_t) uart->usart == (uint16_t) &USARTC0 ) {
+     USART_TxDma_Enable(uart, dma, DMA_CH_TRIGSRC_USARTC0_DRE_gc);
+     return;
+   }
+  #endif
+  #ifdef USARTC1
+   if ( (uint16_t) uart->usart == (uint16_t) &USARTC1 ) {
+     USART_TxDma_Enable(uart, dma, DMA_CH_TRIGSRC_USARTC1_DRE_gc);
+     return;
+   }
+  #endif
+  #ifdef USARTD0
+   if ( (uint16_t) uart->usart == (uint16_t) &USARTD0 ) {
+     USART_TxDma_Enable(uart, dma, DMA_CH_TRIGSRC_USARTD0_DRE_gc);
+     return;
+   }
+  #endif
+  #ifdef USARTD1
+   if ( (uint16_t) uart->usart == (uint16_t) &USARTD1 ) {
+     USART_TxDma_Enable(uart, dma, DMA_CH_TRIGSRC_USARTD1_DRE_gc);
+     return;
+   }
+  #endif
+  #ifdef USARTE0
+   if ( (uint16_t) uart->usart == (uint16_t) &USARTE0 ) {
+     USART_TxDma_Enable(uart, dma, DMA_CH_TRIGSRC_USARTE0_DRE_gc);
+     return;
+   }
+  #endif
+  #ifdef USARTE1
+   if ( (uint16_t) uart->usart == (uint16_t) &USARTE1 ) {
+     USART_TxDma_Enable(uart, dma, DMA_CH_TRIGSRC_USARTE1_DRE_gc);
+     return;
+   }
+  #endif
+  #ifdef USARTF0
+   if ( (uint16_t) uart->usart == (uint16_t) &USARTF0 ) {
+     USART_TxDma_Enable(uart, dma, DMA_CH_TRIGSRC_USARTF0_DRE_gc);
+     return;
+   }
+  #endif
+  #ifdef USARTF1
+   if ( (uint16_t) uart->usart == (uint16_t) &USARTF1 ) {
+     USART_TxDma_Enable(uart, dma, DMA_CH_TRIGSRC_USARTF1_DRE_gc);
+     return;
+   }
+  #endif
 }
\ No newline at end of file
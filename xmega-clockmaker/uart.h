@@ -30,6 +30,19 @@
    \endverbatim
  *           \par
  *
+ *           The receive and transmit buffers of UART \em uart_id are
+ *           UART_\em uart_id _RX_SIZE and UART_\em uart_id _TX_SIZE bytes,
+ *           by default USART_RX_BUFFER_SIZE and USART_TX_BUFFER_SIZE (256).
+ *           Define them before including uart.h to change them, e.g. a
+ *           small receive buffer for a command port:
+ * \verbatim
+      #define ENABLE_UART_C1    1
+      #define UART_C1_RX_SIZE  16
+      #include <uart.h>
+   \endverbatim
+ *           The sizes must be powers of 2 from 2 to 256. 'make' lists the
+ *           SRAM used by the buffers after linking.
+ *
  *           \note An AVR-project can use multiple UART's. One shoud take care that
  *           in different source files there are no multiple ENABLE_UART_\em uart_id
  *           definitions for the same UART.
@@ -46,27 +59,65 @@
 #include "usart_driver.h"
 #endif
 
+#include "load.h"
+#include "uart_baud.h"
+
 /*!
  * \brief Macro UART_NO_DATA is returned by uart_getc when no data is present
  */
 #define UART_NO_DATA          0x0100
 
-uint16_t calc_bsel(uint32_t f_cpu, uint32_t baud, int8_t scale, uint8_t clk2x);
+/*!
+ * \brief What uart_write does with data that does not fit in the transmit buffer
+ */
+typedef enum uart_policy {
+  UART_DROP_NEWEST = 0,   /*!< drop the data that does not fit (default) */
+  UART_DROP_OLDEST,       /*!< drop the oldest data that is not sent yet */
+  UART_BLOCK              /*!< wait until the transmitter made room */
+} uart_policy_t;
+
+/*!
+ * \brief Macro UART_DMA_VECT gives the interrupt vector of DMA channel \em ch
+ */
+#define UART_DMA_VECT(ch)     UART_DMA_VECT_(ch)
+#define UART_DMA_VECT_(ch)    DMA_CH ## ch ## _vect
+
 uint16_t uart_getc(USART_data_t *uart);
 void uart_putc(USART_data_t *uart, uint8_t data);
 void uart_puts(USART_data_t *uart, char *s);
+uint16_t uart_write(USART_data_t *uart, const void *buf, uint16_t len);
+uint16_t uart_read(USART_data_t *uart, void *buf, uint16_t len);
+void uart_set_policy(USART_data_t *uart, uart_policy_t policy);
+void uart_dropped(USART_data_t *uart, uint16_t *tx, uint16_t *rx);
 void set_usart_txrx_direction(USART_t *usart);
-void init_uart(USART_data_t *uart, USART_t *usart, uint32_t f_cpu, uint32_t baud, uint8_t clk2x);
+void init_uart(USART_data_t *uart, USART_t *usart, uart_baud_t baud);
 void init_uart_levels(USART_data_t *uart, USART_t *usart,
-                      uint32_t f_cpu, uint32_t baud, uint8_t clk2x,
+                      uart_baud_t baud,
                       USART_RXCINTLVL_t  rxcIntLevel, USART_DREINTLVL_t dreIntLevel);
+void uart_tx_dma(USART_data_t *uart, uint8_t channel);
+bool uart_calc_baud(uint32_t f_cpu, uint32_t baud, uart_baud_t *setting);
+void uart_set_baud(USART_data_t *uart, uart_baud_t baud);
+bool uart_tx_idle(USART_data_t *uart);
 
 #if ENABLE_UART_C0
+#ifndef UART_C0_RX_SIZE
+#define UART_C0_RX_SIZE     USART_RX_BUFFER_SIZE
+#endif
+#ifndef UART_C0_TX_SIZE
+#define UART_C0_TX_SIZE     USART_TX_BUFFER_SIZE
+#endif
+#if USART_BUFFER_SIZE_INVALID(UART_C0_RX_SIZE) || USART_BUFFER_SIZE_INVALID(UART_C0_TX_SIZE)
+#error UART_C0_RX_SIZE and UART_C0_TX_SIZE must be a power of 2 from 2 to 256
+#endif
+
+static volatile uint8_t uartC0_rx[UART_C0_RX_SIZE];
+static volatile uint8_t uartC0_tx[UART_C0_TX_SIZE];
+
 /*!
  *  \brief Global declaration uart with databuffers for UARTC0.
  *         This variable is only defined if the macro ENABLE_UART_C0 is defined.
  */
-USART_data_t uartC0;
+USART_data_t uartC0 = { .buffer = USART_BUFFER_INIT(uartC0_rx, uartC0_tx) };
 
 /*!
  *  \brief Interrupt Service Routine for receiving with UARTC0.
@@ -74,27 +125,58 @@ USART_data_t uartC0;
  */
 ISR(USARTC0_RXC_vect)
 {
+  LOAD_ENTER();
   USART_RXComplete(&uartC0.usart);
+  LOAD_LEAVE(LOAD_UART_RX);
 }
 
+#if defined(UART_TX_DMA_C0)
+/*!
+ *  \brief Interrupt Service Routine for transmitting with UARTC0 by DMA channel
+ *         UART_TX_DMA_C0, see uart_tx_dma.
+ *         This ISR is only defined if the macro UART_TX_DMA_C0 is defined.
+ */
+ISR(UART_DMA_VECT(UART_TX_DMA_C0))
+{
+  LOAD_ENTER();
+  USART_TxDma_Complete(&uartC0);
+  LOAD_LEAVE(LOAD_UART_TX);
+}
+#else
 /*!
  *  \brief Interrupt Service Routine for transmitting with UARTC0.
  *         This ISR is only defined if the macro ENABLE_UART_C0 is defined.
  */
 ISR(USARTC0_DRE_vect)
 {
+  LOAD_ENTER();
   USART_DataRegEmpty(&uartC0.usart);
+  LOAD_LEAVE(LOAD_UART_TX);
 }
 #endif
+#endif
 
 
 #if ENABLE_UART_C1
+#ifndef UART_C1_RX_SIZE
+#define UART_C1_RX_SIZE     USART_RX_BUFFER_SIZE
+#endif
+#ifndef UART_C1_TX_SIZE
+#define UART_C1_TX_SIZE     USART_TX_BUFFER_SIZE
+#endif
+#if USART_BUFFER_SIZE_INVALID(UART_C1_RX_SIZE) || USART_BUFFER_SIZE_INVALID(UART_C1_TX_SIZE)
+#error UART_C1_RX_SIZE and UART_C1_TX_SIZE must be a power of 2 from 2 to 256
+#endif
+
+static volatile uint8_t uartC1_rx[UART_C1_RX_SIZE];
+static volatile uint8_t uartC1_tx[UART_C1_TX_SIZE];
+
 /*!
  *  \brief Global declaration uart with databuffers for UARTC1.
  *         This variable is only defined if the macro ENABLE_UART_C0 is defined.
  *
  */
-USART_data_t uartC1;
+USART_data_t uartC1 = { .buffer = USART_BUFFER_INIT(uartC1_rx, uartC1_tx) };
 
 /*!
  *  \brief Interrupt Service Routine for receiving with UARTC1.
@@ -102,26 +184,57 @@ USART_data_t uartC1;
  */
 ISR(USARTC1_RXC_vect)
 {
+  LOAD_ENTER();
   USART_RXComplete(&uartC1);
+  LOAD_LEAVE(LOAD_UART_RX);
 }
 
+#if defined(UART_TX_DMA_C1)
+/*!
+ *  \brief Interrupt Service Routine for transmitting with UARTC1 by DMA channel
+ *         UART_TX_DMA_C1, see uart_tx_dma.
+ *         This ISR is only defined if the macro UART_TX_DMA_C1 is defined.
+ */
+ISR(UART_DMA_VECT(UART_TX_DMA_C1))
+{
+  LOAD_ENTER();
+  USART_TxDma_Complete(&uartC1);
+  LOAD_LEAVE(LOAD_UART_TX);
+}
+#else
 /*!
  *  \brief Interrupt Service Routine for transmitting with UARTC1.
  *         This ISR is only defined if the macro ENABLE_UART_C1 is defined.
  */
 ISR(USARTC1_DRE_vect)
 {
+  LOAD_ENTER();
   USART_DataRegEmpty(&uartC1);
+  LOAD_LEAVE(LOAD_UART_TX);
 }
 #endif
+#endif
 
 
 #if ENABLE_UART_D0
+#ifndef UART_D0_RX_SIZE
+#define UART_D0_RX_SIZE     USART_RX_BUFFER_SIZE
+#endif
+#ifndef UART_D0_TX_SIZE
+#define UART_D0_TX_SIZE     USART_TX_BUFFER_SIZE
+#endif
+#if USART_BUFFER_SIZE_INVALID(UART_D0_RX_SIZE) || USART_BUFFER_SIZE_INVALID(UART_D0_TX_SIZE)
+#error UART_D0_RX_SIZE and UART_D0_TX_SIZE must be a power of 2 from 2 to 256
+#endif
+
+static volatile uint8_t uartD0_rx[UART_D0_RX_SIZE];
+static volatile uint8_t uartD0_tx[UART_D0_TX_SIZE];
+
 /*!
  *  \brief Global declaration uart with databuffers for UARTD0.
  *         This variable is only defined if the macro ENABLE_UART_D0 is defined.
  */
-USART_data_t uartD0;
+USART_data_t uartD0 = { .buffer = USART_BUFFER_INIT(uartD0_rx, uartD0_tx) };
 
 /*!
  *  \brief Interrupt Service Routine for receiving with UARTD0.
@@ -129,26 +242,57 @@ USART_data_t uartD0;
  */
 ISR(USARTD0_RXC_vect)
 {
+  LOAD_ENTER();
   USART_RXComplete(&uartD0);
+  LOAD_LEAVE(LOAD_UART_RX);
 }
 
+#if defined(UART_TX_DMA_D0)
+/*!
+ *  \brief Interrupt Service Routine for transmitting with UARTD0 by DMA channel
+ *         UART_TX_DMA_D0, see uart_tx_dma.
+ *         This ISR is only defined if the macro UART_TX_DMA_D0 is defined.
+ */
+ISR(UART_DMA_VECT(UART_TX_DMA_D0))
+{
+  LOAD_ENTER();
+  USART_TxDma_Complete(&uartD0);
+  LOAD_LEAVE(LOAD_UART_TX);
+}
+#else
 /*!
  *  \brief Interrupt Service Routine for transmitting with UARTD0.
  *         This ISR is only defined if the macro ENABLE_UART_D0 is defined.
  */
 ISR(USARTD0_DRE_vect)
 {
+  LOAD_ENTER();
   USART_DataRegEmpty(&uartD0);
+  LOAD_LEAVE(LOAD_UART_TX);
 }
 #endif
+#endif
 
 
 #if ENABLE_UART_D1
+#ifndef UART_D1_RX_SIZE
+#define UART_D1_RX_SIZE     USART_RX_BUFFER_SIZE
+#endif
+#ifndef UART_D1_TX_SIZE
+#define UART_D1_TX_SIZE     USART_TX_BUFFER_SIZE
+#endif
+#if USART_BUFFER_SIZE_INVALID(UART_D1_RX_SIZE) || USART_BUFFER_SIZE_INVALID(UART_D1_TX_SIZE)
+#error UART_D1_RX_SIZE and UART_D1_TX_SIZE must be a power of 2 from 2 to 256
+#endif
+
+static volatile uint8_t uartD1_rx[UART_D1_RX_SIZE];
+static volatile uint8_t uartD1_tx[UART_D1_TX_SIZE];
+
 /*!
  *  \brief Global declaration uart with databuffers for UARTD1.
  *         This variable is only defined if the macro ENABLE_UART_D1 is defined.
  */
-USART_data_t uartD1;
+USART_data_t uartD1 = { .buffer = USART_BUFFER_INIT(uartD1_rx, uartD1_tx) };
 
 /*!
  *  \brief Interrupt Service Routine for receiving with UARTD1.
@@ -156,26 +300,57 @@ USART_data_t uartD1;
  */
 ISR(USARTD1_RXC_vect)
 {
+  LOAD_ENTER();
   USART_RXComplete(&uartD1);
+  LOAD_LEAVE(LOAD_UART_RX);
 }
 
+#if defined(UART_TX_DMA_D1)
+/*!
+ *  \brief Interrupt Service Routine for transmitting with UARTD1 by DMA channel
+ *         UART_TX_DMA_D1, see uart_tx_dma.
+ *         This ISR is only defined if the macro UART_TX_DMA_D1 is defined.
+ */
+ISR(UART_DMA_VECT(UART_TX_DMA_D1))
+{
+  LOAD_ENTER();
+  USART_TxDma_Complete(&uartD1);
+  LOAD_LEAVE(LOAD_UART_TX);
+}
+#else
 /*!
  *  \brief Interrupt Service Routine for transmitting with UARTD1.
  *         This ISR is only defined if the macro ENABLE_UART_D1 is defined.
  */
 ISR(USARTD1_DRE_vect)
 {
+  LOAD_ENTER();
   USART_DataRegEmpty(&uartD1);
+  LOAD_LEAVE(LOAD_UART_TX);
 }
 #endif
+#endif
 
 
 #if ENABLE_UART_E0
+#ifndef UART_E0_RX_SIZE
+#define UART_E0_RX_SIZE     USART_RX_BUFFER_SIZE
+#endif
+#ifndef UART_E0_TX_SIZE
+#define UART_E0_TX_SIZE     USART_TX_BUFFER_SIZE
+#endif
+#if USART_BUFFER_SIZE_INVALID(UART_E0_RX_SIZE) || USART_BUFFER_SIZE_INVALID(UART_E0_TX_SIZE)
+#error UART_E0_RX_SIZE and UART_E0_TX_SIZE must be a power of 2 from 2 to 256
+#endif
+
+static volatile uint8_t uartE0_rx[UART_E0_RX_SIZE];
+static volatile uint8_t uartE0_tx[UART_E0_TX_SIZE];
+
 /*!
  *  \brief Global declaration uart with databuffers for UARTE0.
  *         This variable is only defined if the macro ENABLE_UART_E0 is defined.
  */
-USART_data_t uartE0;
+USART_data_t uartE0 = { .buffer = USART_BUFFER_INIT(uartE0_rx, uartE0_tx) };
 
 /*!
  *  \brief Interrupt Service Routine for receiving with UARTE0.
@@ -183,26 +358,57 @@ USART_data_t uartE0;
  */
 ISR(USARTE0_RXC_vect)
 {
+  LOAD_ENTER();
   USART_RXComplete(&uartE0);
+  LOAD_LEAVE(LOAD_UART_RX);
 }
 
+#if defined(UART_TX_DMA_E0)
+/*!
+ *  \brief Interrupt Service Routine for transmitting with UARTE0 by DMA channel
+ *         UART_TX_DMA_E0, see uart_tx_dma.
+ *         This ISR is only defined if the macro UART_TX_DMA_E0 is defined.
+ */
+ISR(UART_DMA_VECT(UART_TX_DMA_E0))
+{
+  LOAD_ENTER();
+  USART_TxDma_Complete(&uartE0);
+  LOAD_LEAVE(LOAD_UART_TX);
+}
+#else
 /*!
  *  \brief Interrupt Service Routine for transmitting with UARTE0.
  *         This ISR is only defined if the macro ENABLE_UART_E0 is defined.
  */
 ISR(USARTE0_DRE_vect)
 {
+  LOAD_ENTER();
   USART_DataRegEmpty(&uartE0);
+  LOAD_LEAVE(LOAD_UART_TX);
 }
 #endif
+#endif
 
 
 #if ENABLE_UART_E1
+#ifndef UART_E1_RX_SIZE
+#define UART_E1_RX_SIZE     USART_RX_BUFFER_SIZE
+#endif
+#ifndef UART_E1_TX_SIZE
+#define UART_E1_TX_SIZE     USART_TX_BUFFER_SIZE
+#endif
+#if USART_BUFFER_SIZE_INVALID(UART_E1_RX_SIZE) || USART_BUFFER_SIZE_INVALID(UART_E1_TX_SIZE)
+#error UART_E1_RX_SIZE and UART_E1_TX_SIZE must be a power of 2 from 2 to 256
+#endif
+
+static volatile uint8_t uartE1_rx[UART_E1_RX_SIZE];
+static volatile uint8_t uartE1_tx[UART_E1_TX_SIZE];
+
 /*!
  *  \brief Global declaration uart with databuffers for UARTE1.
  *         This variable is only defined if the macro ENABLE_UART_E1 is defined.
  */
-USART_data_t uartE1;
+USART_data_t uartE1 = { .buffer = USART_BUFFER_INIT(uartE1_rx, uartE1_tx) };
 
 /*!
  *  \brief Interrupt Service Routine for receiving with UARTE1.
@@ -210,26 +416,57 @@ USART_data_t uartE1;
  */
 ISR(USARTE1_RXC_vect)
 {
+  LOAD_ENTER();
   USART_RXComplete(&uartE1);
+  LOAD_LEAVE(LOAD_UART_RX);
 }
 
+#if defined(UART_TX_DMA_E1)
+/*!
+ *  \brief Interrupt Service Routine for transmitting with UARTE1 by DMA channel
+ *         UART_TX_DMA_E1, see uart_tx_dma.
+ *         This ISR is only defined if the macro UART_TX_DMA_E1 is defined.
+ */
+ISR(UART_DMA_VECT(UART_TX_DMA_E1))
+{
+  LOAD_ENTER();
+  USART_TxDma_Complete(&uartE1);
+  LOAD_LEAVE(LOAD_UART_TX);
+}
+#else
 /*!
  *  \brief Interrupt Service Routine for transmitting with UARTE1.
  *         This ISR is only defined if the macro ENABLE_UART_E1 is defined.
  */
 ISR(USARTE1_DRE_vect)
 {
+  LOAD_ENTER();
   USART_DataRegEmpty(&uartE1);
+  LOAD_LEAVE(LOAD_UART_TX);
 }
 #endif
+#endif
 
 
 #if ENABLE_UART_F0
+#ifndef UART_F0_RX_SIZE
+#define UART_F0_RX_SIZE     USART_RX_BUFFER_SIZE
+#endif
+#ifndef UART_F0_TX_SIZE
+#define UART_F0_TX_SIZE     USART_TX_BUFFER_SIZE
+#endif
+#if USART_BUFFER_SIZE_INVALID(UART_F0_RX_SIZE) || USART_BUFFER_SIZE_INVALID(UART_F0_TX_SIZE)
+#error UART_F0_RX_SIZE and UART_F0_TX_SIZE must be a power of 2 from 2 to 256
+#endif
+
+static volatile uint8_t uartF0_rx[UART_F0_RX_SIZE];
+static volatile uint8_t uartF0_tx[UART_F0_TX_SIZE];
+
 /*!
  *  \brief Global declaration uart with databuffers for UARTF0.
  *         This variable is only defined if the macro ENABLE_UART_F0 is defined
  */
-USART_data_t uartF0;
+USART_data_t uartF0 = { .buffer = USART_BUFFER_INIT(uartF0_rx, uartF0_tx) };
 
 /*!
  *  \brief Interrupt Service Routine for receiving with UARTF0.
@@ -237,26 +474,57 @@ USART_data_t uartF0;
  */
 ISR(USARTF0_RXC_vect)
 {
+  LOAD_ENTER();
   USART_RXComplete(&uartF0);
+  LOAD_LEAVE(LOAD_UART_RX);
 }
 
+#if defined(UART_TX_DMA_F0)
+/*!
+ *  \brief Interrupt Service Routine for transmitting with UARTF0 by DMA channel
+ *         UART_TX_DMA_F0, see uart_tx_dma.
+ *         This ISR is only defined if the macro UART_TX_DMA_F0 is defined.
+ */
+ISR(UART_DMA_VECT(UART_TX_DMA_F0))
+{
+  LOAD_ENTER();
+  USART_TxDma_Complete(&uartF0);
+  LOAD_LEAVE(LOAD_UART_TX);
+}
+#else
 /*!
  *  \brief Interrupt Service Routine for transmitting with UARTF0.
  *         This ISR is only defined if the macro ENABLE_UART_F0 is defined
  */
 ISR(USARTF0_DRE_vect)
 {
+  LOAD_ENTER();
   USART_DataRegEmpty(&uartF0);
+  LOAD_LEAVE(LOAD_UART_TX);
 }
 #endif
+#endif
 
 
 #if ENABLE_UART_F1
+#ifndef UART_F1_RX_SIZE
+#define UART_F1_RX_SIZE     USART_RX_BUFFER_SIZE
+#endif
+#ifndef UART_F1_TX_SIZE
+#define UART_F1_TX_SIZE     USART_TX_BUFFER_SIZE
+#endif
+#if USART_BUFFER_SIZE_INVALID(UART_F1_RX_SIZE) || USART_BUFFER_SIZE_INVALID(UART_F1_TX_SIZE)
+#error UART_F1_RX_SIZE and UART_F1_TX_SIZE must be a power of 2 from 2 to 256
+#endif
+
+static volatile uint8_t uartF1_rx[UART_F1_RX_SIZE];
+static volatile uint8_t uartF1_tx[UART_F1_TX_SIZE];
+
 /*!
  *  \brief Global declaration uart with databuffers for UARTF1.
  *         This variable is only defined if the macro ENABLE_UART_F1 is defined
  */
-USART_data_t uartF1;
+USART_data_t uartF1 = { .buffer = USART_BUFFER_INIT(uartF1_rx, uartF1_tx) };
 
 /*!
  *  \brief Interrupt Service Routine for receiving with UARTF1.
@@ -264,15 +532,33 @@ USART_data_t uartF1;
  */
 ISR(USARTF1_RXC_vect)
 {
+  LOAD_ENTER();
   USART_RXComplete(&uartF1);
+  LOAD_LEAVE(LOAD_UART_RX);
 }
 
+#if defined(UART_TX_DMA_F1)
+/*!
+ *  \brief Interrupt Service Routine for transmitting with UARTF1 by DMA channel
+ *         UART_TX_DMA_F1, see uart_tx_dma.
+ *         This ISR is only defined if the macro UART_TX_DMA_F1 is defined.
+ */
+ISR(UART_DMA_VECT(UART_TX_DMA_F1))
+{
+  LOAD_ENTER();
+  USART_TxDma_Complete(&uartF1);
+  LOAD_LEAVE(LOAD_UART_TX);
+}
+#else
 /*!
  *  \brief Interrupt Service Routine for transmitting with UARTF1.
  *         This ISR is only defined if the macro ENABLE_UART_F1 is defined
  */
 ISR(USARTF1_DRE_vect)
 {
+  LOAD_ENTER();
   USART_DataRegEmpty(&uartF1);
+  LOAD_LEAVE(LOAD_UART_TX);
 }
+#endif
 #endif
\ No newline at end of file
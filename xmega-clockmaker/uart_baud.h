@@ -0,0 +1,236 @@
+//       _____ ____          //
+//      |___  |  _ \         //
+//         _| | |_) |        //
+//        |_  |  _ <         //
+//          |_|_| \_\        //
+//                           //
+// Written By Floris Romeijn //
+
+/* Baud rate settings of the XMEGA USART, like avr-libc's <util/setbaud.h>.
+ *
+ * Included by uart.h for the formulas. Define BAUD and include it again to
+ * have BAUD_BSEL, BAUD_BSCALE and BAUD_CLK2X worked out by the preprocessor
+ * for F_CPU, the build stops if the error is above BAUD_MAX_ERROR_PPM:
+ *
+ *   #define BAUD 230400UL
+ *   #include "uart_baud.h"
+ *   init_uart(&uartF0, &USARTF0, BAUD_SETTING);
+ *
+ * The USART divides the peripheral clock by N = 16 (8 with CLK2X) and
+ *
+ *   BSCALE >= 0:  baud = f_cpu / (N * 2^BSCALE * (BSEL + 1))
+ *   BSCALE <  0:  baud = f_cpu / (N * (BSEL * 2^BSCALE + 1))
+ *
+ * Both are f_cpu * k / (N * p * (BSEL + k)) with p = 2^BSCALE, k = 1 for a
+ * positive and p = 1, k = 2^-BSCALE for a negative BSCALE. For each N the
+ * most negative BSCALE that fits BSEL in 12 bits has the finest steps; of
+ * the two, CLK2X is only taken when it is more accurate, its receiver takes
+ * 8 instead of 16 samples per bit. 1, 2 and 4 Mbaud are exact at 32 MHz, the
+ * last one only with CLK2X.
+ */
+
+#ifndef UART_BAUD_H
+#define UART_BAUD_H
+
+#include <stdint.h>
+
+/*! \brief Largest baud rate error accepted, in ppm of the rate asked for. */
+#ifndef BAUD_MAX_ERROR_PPM
+#define BAUD_MAX_ERROR_PPM 10000UL
+#endif
+
+/*! \brief USART baud rate registers, see BAUD_SETTING and uart_calc_baud(). */
+typedef struct uart_baud {
+	/* \brief BAUDCTRLA and the low bits of BAUDCTRLB */
+	uint16_t bsel;
+	/* \brief -7 to 7 */
+	int8_t bscale;
+	/* \brief 1 for double speed (CTRLB CLK2X) */
+	uint8_t clk2x;
+} uart_baud_t;
+
+/* Constant expressions for the preprocessor as well as the compiler, so no
+ * casts: 0ULL + forces 64 bit arithmetic, f_cpu * 128 does not fit 32 bit.
+ * A baud rate above f_cpu / N wraps around to a BSEL far above 4095. */
+#define UART_BAUD_N(clk2x) (16ULL >> (clk2x))
+#define UART_BAUD_BSEL(f_cpu, baud, clk2x, p, k) \
+	((2 * (0ULL + (f_cpu) - UART_BAUD_N(clk2x) * (baud) * (p)) * (k) + UART_BAUD_N(clk2x) * (baud) * (p)) \
+	 / (2 * UART_BAUD_N(clk2x) * (baud) * (p)))
+#define UART_BAUD_PERIOD(f_cpu, baud, clk2x, p, k) \
+	(UART_BAUD_N(clk2x) * (baud) * (p) * (UART_BAUD_BSEL(f_cpu, baud, clk2x, p, k) + (k)))
+#define UART_BAUD_ERROR_PPM(f_cpu, baud, clk2x, p, k) \
+	(((0ULL + (f_cpu)) * (k) > UART_BAUD_PERIOD(f_cpu, baud, clk2x, p, k) \
+	  ? (0ULL + (f_cpu)) * (k) - UART_BAUD_PERIOD(f_cpu, baud, clk2x, p, k) \
+	  : UART_BAUD_PERIOD(f_cpu, baud, clk2x, p, k) - (0ULL + (f_cpu)) * (k)) \
+	 * 1000000 / ((0ULL + (f_cpu)) * (k)))
+
+#endif // UART_BAUD_H
+
+#ifdef BAUD
+
+#undef BAUD_BSEL
+#undef BAUD_BSCALE
+#undef BAUD_CLK2X
+#undef BAUD_ERROR_PPM
+#undef BAUD_P_
+#undef BAUD_K_
+#undef BAUD_P0_
+#undef BAUD_K0_
+#undef BAUD_S0_
+#undef BAUD_P1_
+#undef BAUD_K1_
+#undef BAUD_S1_
+
+/* finest BSCALE with a 12 bit BSEL, normal speed */
+#if UART_BAUD_BSEL(F_CPU, BAUD, 0, 1, 128) < 4096
+#define BAUD_S0_ -7
+#define BAUD_P0_ 1
+#define BAUD_K0_ 128
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 0, 1, 64) < 4096
+#define BAUD_S0_ -6
+#define BAUD_P0_ 1
+#define BAUD_K0_ 64
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 0, 1, 32) < 4096
+#define BAUD_S0_ -5
+#define BAUD_P0_ 1
+#define BAUD_K0_ 32
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 0, 1, 16) < 4096
+#define BAUD_S0_ -4
+#define BAUD_P0_ 1
+#define BAUD_K0_ 16
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 0, 1, 8) < 4096
+#define BAUD_S0_ -3
+#define BAUD_P0_ 1
+#define BAUD_K0_ 8
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 0, 1, 4) < 4096
+#define BAUD_S0_ -2
+#define BAUD_P0_ 1
+#define BAUD_K0_ 4
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 0, 1, 2) < 4096
+#define BAUD_S0_ -1
+#define BAUD_P0_ 1
+#define BAUD_K0_ 2
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 0, 1, 1) < 4096
+#define BAUD_S0_ 0
+#define BAUD_P0_ 1
+#define BAUD_K0_ 1
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 0, 2, 1) < 4096
+#define BAUD_S0_ 1
+#define BAUD_P0_ 2
+#define BAUD_K0_ 1
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 0, 4, 1) < 4096
+#define BAUD_S0_ 2
+#define BAUD_P0_ 4
+#define BAUD_K0_ 1
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 0, 8, 1) < 4096
+#define BAUD_S0_ 3
+#define BAUD_P0_ 8
+#define BAUD_K0_ 1
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 0, 16, 1) < 4096
+#define BAUD_S0_ 4
+#define BAUD_P0_ 16
+#define BAUD_K0_ 1
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 0, 32, 1) < 4096
+#define BAUD_S0_ 5
+#define BAUD_P0_ 32
+#define BAUD_K0_ 1
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 0, 64, 1) < 4096
+#define BAUD_S0_ 6
+#define BAUD_P0_ 64
+#define BAUD_K0_ 1
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 0, 128, 1) < 4096
+#define BAUD_S0_ 7
+#define BAUD_P0_ 128
+#define BAUD_K0_ 1
+#endif
+
+/* the same with CLK2X */
+#if UART_BAUD_BSEL(F_CPU, BAUD, 1, 1, 128) < 4096
+#define BAUD_S1_ -7
+#define BAUD_P1_ 1
+#define BAUD_K1_ 128
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 1, 1, 64) < 4096
+#define BAUD_S1_ -6
+#define BAUD_P1_ 1
+#define BAUD_K1_ 64
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 1, 1, 32) < 4096
+#define BAUD_S1_ -5
+#define BAUD_P1_ 1
+#define BAUD_K1_ 32
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 1, 1, 16) < 4096
+#define BAUD_S1_ -4
+#define BAUD_P1_ 1
+#define BAUD_K1_ 16
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 1, 1, 8) < 4096
+#define BAUD_S1_ -3
+#define BAUD_P1_ 1
+#define BAUD_K1_ 8
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 1, 1, 4) < 4096
+#define BAUD_S1_ -2
+#define BAUD_P1_ 1
+#define BAUD_K1_ 4
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 1, 1, 2) < 4096
+#define BAUD_S1_ -1
+#define BAUD_P1_ 1
+#define BAUD_K1_ 2
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 1, 1, 1) < 4096
+#define BAUD_S1_ 0
+#define BAUD_P1_ 1
+#define BAUD_K1_ 1
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 1, 2, 1) < 4096
+#define BAUD_S1_ 1
+#define BAUD_P1_ 2
+#define BAUD_K1_ 1
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 1, 4, 1) < 4096
+#define BAUD_S1_ 2
+#define BAUD_P1_ 4
+#define BAUD_K1_ 1
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 1, 8, 1) < 4096
+#define BAUD_S1_ 3
+#define BAUD_P1_ 8
+#define BAUD_K1_ 1
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 1, 16, 1) < 4096
+#define BAUD_S1_ 4
+#define BAUD_P1_ 16
+#define BAUD_K1_ 1
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 1, 32, 1) < 4096
+#define BAUD_S1_ 5
+#define BAUD_P1_ 32
+#define BAUD_K1_ 1
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 1, 64, 1) < 4096
+#define BAUD_S1_ 6
+#define BAUD_P1_ 64
+#define BAUD_K1_ 1
+#elif UART_BAUD_BSEL(F_CPU, BAUD, 1, 128, 1) < 4096
+#define BAUD_S1_ 7
+#define BAUD_P1_ 128
+#define BAUD_K1_ 1
+#endif
+
+#if !defined(BAUD_S0_) && !defined(BAUD_S1_)
+#error "BAUD is out of range of the USART at F_CPU"
+#elif !defined(BAUD_S1_) || (defined(BAUD_S0_) && \
+	UART_BAUD_ERROR_PPM(F_CPU, BAUD, 0, BAUD_P0_, BAUD_K0_) <= UART_BAUD_ERROR_PPM(F_CPU, BAUD, 1, BAUD_P1_, BAUD_K1_))
+#define BAUD_CLK2X 0
+#define BAUD_BSCALE BAUD_S0_
+#define BAUD_P_ BAUD_P0_
+#define BAUD_K_ BAUD_K0_
+#else
+#define BAUD_CLK2X 1
+#define BAUD_BSCALE BAUD_S1_
+#define BAUD_P_ BAUD_P1_
+#define BAUD_K_ BAUD_K1_
+#endif
+
+/*! \brief BSEL of BAUD at F_CPU. */
+#define BAUD_BSEL ((uint16_t)UART_BAUD_BSEL(F_CPU, BAUD, BAUD_CLK2X, BAUD_P_, BAUD_K_))
+/*! \brief Difference between BAUD and the rate the USART makes, in ppm. */
+#define BAUD_ERROR_PPM UART_BAUD_ERROR_PPM(F_CPU, BAUD, BAUD_CLK2X, BAUD_P_, BAUD_K_)
+/*! \brief All three as a uart_baud_t for init_uart() and uart_set_baud(). */
+#define BAUD_SETTING ((uart_baud_t){ BAUD_BSEL, BAUD_BSCALE, BAUD_CLK2X })
+
+#if UART_BAUD_ERROR_PPM(F_CPU, BAUD, BAUD_CLK2X, BAUD_P_, BAUD_K_) > BAUD_MAX_ERROR_PPM
+#error "BAUD is more than BAUD_MAX_ERROR_PPM off at F_CPU"
+#endif
+
+#endif // BAUD
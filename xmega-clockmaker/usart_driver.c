@@ -72,7 +72,8 @@
 /*! \brief Initializes buffer and selects what USART module to use.
  *
  *  Initializes receive and transmit buffer and selects what USART module to use,
- *  and stores the data register empty interrupt level.
+ *  and stores the data register empty interrupt level. The buffer storage must
+ *  be set already, see USART_BUFFER_INIT.
  *
  *  \param usart_data           The USART_data_t struct instance.
  *  \param usart                The USART module.
@@ -89,6 +90,13 @@ void USART_InterruptDriver_Initialize(USART_data_t * usart_data,
 	usart_data->buffer.RX_Head = 0;
 	usart_data->buffer.TX_Tail = 0;
 	usart_data->buffer.TX_Head = 0;
+
+	usart_data->txDma = NULL;
+	usart_data->txDmaCount = 0;
+
+	usart_data->txPolicy = 0;
+	usart_data->txDropped = 0;
+	usart_data->rxDropped = 0;
 }
 
 
@@ -123,7 +131,7 @@ void USART_InterruptDriver_DreInterruptLevel_Set(USART_data_t * usart_data,
 bool USART_TXBuffer_FreeSpace(USART_data_t * usart_data)
 {
 	/* Make copies to make sure that volatile access is specified. */
-	uint8_t tempHead = (usart_data->buffer.TX_Head + 1) & USART_TX_BUFFER_MASK;
+	uint8_t tempHead = (usart_data->buffer.TX_Head + 1) & usart_data->buffer.TX_Mask;
 	uint8_t tempTail = usart_data->buffer.TX_Tail;
 
 	/* There are data left in the buffer unless Head and Tail are equal. */
@@ -156,14 +164,144 @@ bool USART_TXBuffer_PutByte(USART_data_t * usart_data, uint8_t data)
 	  	tempTX_Head = TXbufPtr->TX_Head;
 	  	TXbufPtr->TX[tempTX_Head]= data;
 		/* Advance buffer head. */
-		TXbufPtr->TX_Head = (tempTX_Head + 1) & USART_TX_BUFFER_MASK;
+		TXbufPtr->TX_Head = (tempTX_Head + 1) & TXbufPtr->TX_Mask;
+
+		if (usart_data->txDma != NULL) {
+			/* Start the DMA channel unless it is busy. */
+			AVR_ENTER_CRITICAL_REGION();
+			USART_TxDma_Start(usart_data);
+			AVR_LEAVE_CRITICAL_REGION();
+		}else{
+			/* Enable DRE interrupt. */
+			tempCTRLA = usart_data->usart->CTRLA;
+			tempCTRLA = (tempCTRLA & ~USART_DREINTLVL_gm) | usart_data->dreIntLevel;
+			usart_data->usart->CTRLA = tempCTRLA;
+		}
+	}
+	return TXBuffer_FreeSpace;
+}
+
+
+
+/*! \brief Number of free bytes in the transmitter software buffer.
+ *
+ *  \param usart_data The USART_data_t struct instance.
+ *
+ *  \return          Bytes that can be stored before the buffer is full.
+ */
+uint8_t USART_TXBuffer_FreeCount(USART_data_t * usart_data)
+{
+	/* Make copies to make sure that volatile access is specified. */
+	uint8_t tempHead = usart_data->buffer.TX_Head;
+	uint8_t tempTail = usart_data->buffer.TX_Tail;
+
+	return (tempTail - tempHead - 1) & usart_data->buffer.TX_Mask;
+}
+
+
+
+/*! \brief Put a block of data (5-8 bit characters).
+ *
+ *  Stores as much of the data as fits in the TX software buffer in one pass
+ *  and then starts the transmitter once: enables the DRE interrupt or hands
+ *  the data to the DMA channel.
+ *
+ *  \param usart_data The USART_data_t struct instance.
+ *  \param data       The data to send.
+ *  \param count      Number of bytes in \em data.
+ *
+ *  \return          Number of bytes stored.
+ */
+uint8_t USART_TXBuffer_PutBytes(USART_data_t * usart_data, const uint8_t * data, uint8_t count)
+{
+	uint8_t tempTX_Head;
+	uint8_t freeCount;
+	USART_Buffer_t * TXbufPtr;
+
+	TXbufPtr = &usart_data->buffer;
+	freeCount = USART_TXBuffer_FreeCount(usart_data);
+	if (count > freeCount) {
+		count = freeCount;
+	}
+	if (count == 0) {
+		return 0;
+	}
+
+	tempTX_Head = TXbufPtr->TX_Head;
+	for (uint8_t i = 0; i < count; i++) {
+		TXbufPtr->TX[tempTX_Head] = data[i];
+		tempTX_Head = (tempTX_Head + 1) & TXbufPtr->TX_Mask;
+	}
+	USART_TXBuffer_Commit(usart_data, tempTX_Head);
+
+	return count;
+}
+
 
+
+/*! \brief Transmit data written directly into the TX software buffer.
+ *
+ *  For data built in place: the caller writes TX[TX_Head] onwards (wrapping
+ *  with TX_Mask, at most USART_TXBuffer_FreeCount bytes) and then calls this
+ *  function with the new head. It advances the head and starts the
+ *  transmitter once: enables the DRE interrupt or hands the data to the DMA
+ *  channel.
+ *
+ *  \param usart_data The USART_data_t struct instance.
+ *  \param head       Index after the last byte written.
+ */
+void USART_TXBuffer_Commit(USART_data_t * usart_data, uint8_t head)
+{
+	uint8_t tempCTRLA;
+
+	/* Advance buffer head. */
+	usart_data->buffer.TX_Head = head;
+
+	if (usart_data->txDma != NULL) {
+		AVR_ENTER_CRITICAL_REGION();
+		USART_TxDma_Start(usart_data);
+		AVR_LEAVE_CRITICAL_REGION();
+	}else{
 		/* Enable DRE interrupt. */
 		tempCTRLA = usart_data->usart->CTRLA;
 		tempCTRLA = (tempCTRLA & ~USART_DREINTLVL_gm) | usart_data->dreIntLevel;
 		usart_data->usart->CTRLA = tempCTRLA;
 	}
-	return TXBuffer_FreeSpace;
+}
+
+
+
+/*! \brief Drop the oldest data of the transmitter software buffer.
+ *
+ *  Removes up to \em count bytes that have not been transmitted yet. With a
+ *  DMA channel the running chunk is stopped first, so only the bytes already
+ *  sent are kept out of the count; the caller restarts the transmitter, e.g.
+ *  with USART_TXBuffer_PutBytes.
+ *
+ *  \param usart_data The USART_data_t struct instance.
+ *  \param count      Number of bytes to drop.
+ *
+ *  \return          Number of bytes dropped.
+ */
+uint8_t USART_TXBuffer_Discard(USART_data_t * usart_data, uint8_t count)
+{
+	USART_Buffer_t * bufPtr;
+	uint8_t used;
+
+	bufPtr = &usart_data->buffer;
+
+	AVR_ENTER_CRITICAL_REGION();
+	if (usart_data->txDma != NULL) {
+		USART_TxDma_Stop(usart_data);
+	}
+	used = (bufPtr->TX_Head - bufPtr->TX_Tail) & bufPtr->TX_Mask;
+	if (count > used) {
+		count = used;
+	}
+	bufPtr->TX_Tail = (bufPtr->TX_Tail + count) & bufPtr->TX_Mask;
+	AVR_LEAVE_CRITICAL_REGION();
+
+	return count;
 }
 
 
@@ -210,13 +348,48 @@ uint8_t USART_RXBuffer_GetByte(USART_data_t * usart_data)
 	ans = (bufPtr->RX[bufPtr->RX_Tail]);
 
 	/* Advance buffer tail. */
-	bufPtr->RX_Tail = (bufPtr->RX_Tail + 1) & USART_RX_BUFFER_MASK;
+	bufPtr->RX_Tail = (bufPtr->RX_Tail + 1) & bufPtr->RX_Mask;
 
 	return ans;
 }
 
 
 
+/*! \brief Get a block of received data (5-8 bit characters).
+ *
+ *  Copies up to \em count bytes from the RX software buffer in one pass.
+ *
+ *  \param usart_data       The USART_data_t struct instance.
+ *  \param data             Destination of the received data.
+ *  \param count            Size of \em data.
+ *
+ *  \return         Number of bytes copied.
+ */
+uint8_t USART_RXBuffer_GetBytes(USART_data_t * usart_data, uint8_t * data, uint8_t count)
+{
+	USART_Buffer_t * bufPtr;
+	uint8_t tempRX_Tail;
+	uint8_t available;
+
+	bufPtr = &usart_data->buffer;
+	tempRX_Tail = bufPtr->RX_Tail;
+	available = (bufPtr->RX_Head - tempRX_Tail) & bufPtr->RX_Mask;
+	if (count > available) {
+		count = available;
+	}
+
+	for (uint8_t i = 0; i < count; i++) {
+		data[i] = bufPtr->RX[tempRX_Tail];
+		tempRX_Tail = (tempRX_Tail + 1) & usart_data->buffer.RX_Mask;
+	}
+	/* Advance buffer tail. */
+	bufPtr->RX_Tail = tempRX_Tail;
+
+	return count;
+}
+
+
+
 /*! \brief RX Complete Interrupt Service Routine.
  *
  *  RX Complete Interrupt Service Routine.
@@ -231,7 +404,7 @@ bool USART_RXComplete(USART_data_t * usart_data)
 
 	bufPtr = &usart_data->buffer;
 	/* Advance buffer head. */
-	uint8_t tempRX_Head = (bufPtr->RX_Head + 1) & USART_RX_BUFFER_MASK;
+	uint8_t tempRX_Head = (bufPtr->RX_Head + 1) & bufPtr->RX_Mask;
 
 	/* Check for overflow. */
 	uint8_t tempRX_Tail = bufPtr->RX_Tail;
@@ -239,6 +412,7 @@ bool USART_RXComplete(USART_data_t * usart_data)
 
 	if (tempRX_Head == tempRX_Tail) {
 	  	ans = false;
+		usart_data->rxDropped++;
 	}else{
 		ans = true;
 		usart_data->buffer.RX[usart_data->buffer.RX_Head] = data;
@@ -276,8 +450,150 @@ void USART_DataRegEmpty(USART_data_t * usart_data)
 		usart_data->usart->DATA = data;
 
 		/* Advance buffer tail. */
-		bufPtr->TX_Tail = (bufPtr->TX_Tail + 1) & USART_TX_BUFFER_MASK;
+		bufPtr->TX_Tail = (bufPtr->TX_Tail + 1) & bufPtr->TX_Mask;
+	}
+}
+
+
+/*! \brief Transmit with a DMA channel instead of the DRE interrupt.
+ *
+ *  The DMA channel copies contiguous chunks of the TX software buffer to the
+ *  DATA register, one byte per DRE trigger. The CPU only takes one interrupt
+ *  per chunk, in which USART_TxDma_Complete must be called. The transaction
+ *  complete interrupt uses the DRE interrupt level of the driver.
+ *
+ *  \note Call with an empty TX buffer, right after initialization.
+ *
+ *  \param usart_data   The USART_data_t struct instance.
+ *  \param dma          The DMA channel to use.
+ *  \param dreTrigger   DMA trigger source of the DRE of the USART module.
+ */
+void USART_TxDma_Enable(USART_data_t * usart_data, DMA_CH_t * dma,
+                        DMA_CH_TRIGSRC_t dreTrigger)
+{
+	uint16_t dataAddr = (uint16_t) &usart_data->usart->DATA;
+
+	dma->CTRLA = 0;
+	dma->CTRLA = DMA_CH_RESET_bm;
+
+	dma->ADDRCTRL = DMA_CH_SRCRELOAD_NONE_gc | DMA_CH_SRCDIR_INC_gc |
+	                DMA_CH_DESTRELOAD_NONE_gc | DMA_CH_DESTDIR_FIXED_gc;
+	dma->TRIGSRC = dreTrigger;
+	dma->DESTADDR0 = (uint8_t) dataAddr;
+	dma->DESTADDR1 = (uint8_t) (dataAddr >> 8);
+	dma->DESTADDR2 = 0;
+	dma->SRCADDR2 = 0;
+	/* DREINTLVL and TRNINTLVL use the same level encoding. */
+	dma->CTRLB = (uint8_t) usart_data->dreIntLevel;
+
+	DMA.CTRL |= DMA_ENABLE_bm;
+
+	usart_data->txDmaCount = 0;
+	usart_data->txDma = dma;
+}
+
+
+/*! \brief Hand the next contiguous chunk of the TX buffer to the DMA channel.
+ *
+ *  Does nothing while a chunk is being transmitted or when the buffer is
+ *  empty. A chunk ends at the head or at the end of the buffer array, the
+ *  tail only advances when the chunk is complete.
+ *
+ *  \note Call with interrupts disabled or from the DMA interrupt.
+ *
+ *  \param usart_data      The USART_data_t struct instance.
+ */
+void USART_TxDma_Start(USART_data_t * usart_data)
+{
+	USART_Buffer_t * bufPtr;
+	DMA_CH_t * dma = usart_data->txDma;
+	uint8_t tempTX_Head;
+	uint8_t tempTX_Tail;
+	uint16_t count;
+	uint16_t srcAddr;
+
+	if (usart_data->txDmaCount != 0) {
+		return;
+	}
+
+	bufPtr = &usart_data->buffer;
+	tempTX_Head = bufPtr->TX_Head;
+	tempTX_Tail = bufPtr->TX_Tail;
+	if (tempTX_Head == tempTX_Tail) {
+		return;
 	}
+
+	if (tempTX_Head > tempTX_Tail) {
+		count = tempTX_Head - tempTX_Tail;
+	}else{
+		count = (uint16_t) bufPtr->TX_Mask + 1 - tempTX_Tail;
+	}
+
+	srcAddr = (uint16_t) &bufPtr->TX[tempTX_Tail];
+	dma->SRCADDR0 = (uint8_t) srcAddr;
+	dma->SRCADDR1 = (uint8_t) (srcAddr >> 8);
+	dma->TRFCNT = count;
+	usart_data->txDmaCount = count;
+
+	dma->CTRLA = DMA_CH_ENABLE_bm | DMA_CH_SINGLE_bm | DMA_CH_BURSTLEN_1BYTE_gc;
+}
+
+
+/*! \brief Stop the DMA channel in the middle of a chunk.
+ *
+ *  Waits for the running byte, releases the bytes that were sent from the TX
+ *  software buffer and leaves the channel idle. USART_TxDma_Start continues
+ *  with the rest.
+ *
+ *  \note Call with interrupts disabled.
+ *
+ *  \param usart_data      The USART_data_t struct instance.
+ */
+void USART_TxDma_Stop(USART_data_t * usart_data)
+{
+	USART_Buffer_t * bufPtr;
+	DMA_CH_t * dma = usart_data->txDma;
+	uint8_t sent;
+
+	if (usart_data->txDmaCount == 0) {
+		return;
+	}
+
+	bufPtr = &usart_data->buffer;
+	dma->CTRLA &= ~DMA_CH_ENABLE_bm;
+	while (dma->CTRLA & DMA_CH_ENABLE_bm) {
+	}
+
+	if (dma->CTRLB & DMA_CH_TRNIF_bm) {
+		/* Finished meanwhile, the interrupt is cleared here. */
+		dma->CTRLB |= DMA_CH_TRNIF_bm;
+		sent = usart_data->txDmaCount;
+	}else{
+		sent = usart_data->txDmaCount - dma->TRFCNT;
+	}
+	bufPtr->TX_Tail = (bufPtr->TX_Tail + sent) & bufPtr->TX_Mask;
+	usart_data->txDmaCount = 0;
+}
+
+
+/*! \brief DMA transaction complete Interrupt Service Routine.
+ *
+ *  Releases the transmitted chunk from the TX software buffer and starts the
+ *  next one.
+ *
+ *  \param usart_data      The USART_data_t struct instance.
+ */
+void USART_TxDma_Complete(USART_data_t * usart_data)
+{
+	USART_Buffer_t * bufPtr;
+
+	bufPtr = &usart_data->buffer;
+	usart_data->txDma->CTRLB |= DMA_CH_TRNIF_bm;
+
+	bufPtr->TX_Tail = (bufPtr->TX_Tail + usart_data->txDmaCount) & bufPtr->TX_Mask;
+	usart_data->txDmaCount = 0;
+
+	USART_TxDma_Start(usart_data);
 }
 
 
@@ -63,31 +63,39 @@
 
 /* USART buffer defines. */
 
-/* \brief  Receive buffer size: 2,4,8,16,32,64,128 or 256 bytes. */
+/* \brief Default receive buffer size: 2,4,8,16,32,64,128 or 256 bytes. */
 #define USART_RX_BUFFER_SIZE 256
-/* \brief Transmit buffer size: 2,4,8,16,32,64,128 or 256 bytes */
+/* \brief Default transmit buffer size: 2,4,8,16,32,64,128 or 256 bytes */
 #define USART_TX_BUFFER_SIZE 256
-/* \brief Receive buffer mask. */
-#define USART_RX_BUFFER_MASK ( USART_RX_BUFFER_SIZE - 1 )
-/* \brief Transmit buffer mask. */
-#define USART_TX_BUFFER_MASK ( USART_TX_BUFFER_SIZE - 1 )
 
+/* \brief Nonzero if _size is not a valid buffer size. */
+#define USART_BUFFER_SIZE_INVALID(_size)                                       \
+	( (_size) < 2 || (_size) > 256 || ((_size) & ((_size) - 1)) )
 
-#if ( USART_RX_BUFFER_SIZE & USART_RX_BUFFER_MASK )
+
+#if USART_BUFFER_SIZE_INVALID(USART_RX_BUFFER_SIZE)
 #error RX buffer size is not a power of 2
 #endif
-#if ( USART_TX_BUFFER_SIZE & USART_TX_BUFFER_MASK )
+#if USART_BUFFER_SIZE_INVALID(USART_TX_BUFFER_SIZE)
 #error TX buffer size is not a power of 2
 #endif
 
 
-/* \brief USART transmit and receive ring buffer. */
+/* \brief USART transmit and receive ring buffer.
+ *
+ *  The storage is separate so every USART can have its own sizes, set it up
+ *  with USART_BUFFER_INIT.
+ */
 typedef struct USART_Buffer
 {
-	/* \brief Receive buffer. */
-	volatile uint8_t RX[USART_RX_BUFFER_SIZE];
-	/* \brief Transmit buffer. */
-	volatile uint8_t TX[USART_TX_BUFFER_SIZE];
+	/* \brief Receive buffer, RX_Mask + 1 bytes. */
+	volatile uint8_t * RX;
+	/* \brief Transmit buffer, TX_Mask + 1 bytes. */
+	volatile uint8_t * TX;
+	/* \brief Receive buffer mask, the size minus 1. */
+	uint8_t RX_Mask;
+	/* \brief Transmit buffer mask, the size minus 1. */
+	uint8_t TX_Mask;
 	/* \brief Receive buffer head. */
 	volatile uint8_t RX_Head;
 	/* \brief Receive buffer tail. */
@@ -98,6 +106,13 @@ typedef struct USART_Buffer
 	volatile uint8_t TX_Tail;
 } USART_Buffer_t;
 
+/* \brief Initializer of a USART_Buffer_t with the arrays _rx and _tx as storage.
+ *
+ *  The sizes of the arrays must be valid, see USART_BUFFER_SIZE_INVALID.
+ */
+#define USART_BUFFER_INIT(_rx, _tx)                                            \
+	{ (_rx), (_tx), sizeof(_rx) - 1, sizeof(_tx) - 1, 0, 0, 0, 0 }
+
 
 /*! \brief Struct used when interrupt driven driver is used.
 *
@@ -112,6 +127,16 @@ typedef struct Usart_and_buffer
 	USART_DREINTLVL_t dreIntLevel;
 	/* \brief Data buffer. */
 	USART_Buffer_t buffer;
+	/* \brief DMA channel for transmitting, NULL to use the DRE interrupt. */
+	DMA_CH_t * txDma;
+	/* \brief Bytes of the TX buffer the DMA channel is transmitting. */
+	volatile uint8_t txDmaCount;
+	/* \brief What uart_write does when the TX buffer is full (uart_policy_t). */
+	uint8_t txPolicy;
+	/* \brief Bytes dropped because the TX buffer was full. */
+	uint16_t txDropped;
+	/* \brief Bytes dropped because the RX buffer was full. */
+	volatile uint16_t rxDropped;
 } USART_data_t;
 
 
@@ -294,11 +319,22 @@ void USART_InterruptDriver_DreInterruptLevel_Set(USART_data_t * usart_data,
 
 bool USART_TXBuffer_FreeSpace(USART_data_t * usart_data);
 bool USART_TXBuffer_PutByte(USART_data_t * usart_data, uint8_t data);
+uint8_t USART_TXBuffer_FreeCount(USART_data_t * usart_data);
+uint8_t USART_TXBuffer_PutBytes(USART_data_t * usart_data, const uint8_t * data, uint8_t count);
+uint8_t USART_TXBuffer_Discard(USART_data_t * usart_data, uint8_t count);
+void USART_TXBuffer_Commit(USART_data_t * usart_data, uint8_t head);
 bool USART_RXBufferData_Available(USART_data_t * usart_data);
 uint8_t USART_RXBuffer_GetByte(USART_data_t * usart_data);
+uint8_t USART_RXBuffer_GetBytes(USART_data_t * usart_data, uint8_t * data, uint8_t count);
 bool USART_RXComplete(USART_data_t * usart_data);
 void USART_DataRegEmpty(USART_data_t * usart_data);
 
+void USART_TxDma_Enable(USART_data_t * usart_data, DMA_CH_t * dma,
+                        DMA_CH_TRIGSRC_t dreTrigger);
+void USART_TxDma_Start(USART_data_t * usart_data);
+void USART_TxDma_Stop(USART_data_t * usart_data);
+void USART_TxDma_Complete(USART_data_t * usart_data);
+
 /* Functions for polled driver. */
 void USART_NineBits_PutChar(USART_t * usart, uint16_t data);
 uint16_t USART_NineBits_GetChar(USART_t * usart);